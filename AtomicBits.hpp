@@ -0,0 +1,165 @@
+/**
+ * AtomicBits.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Bit set that many threads can read and write at once without locks, every
+ * single bit operation is one atomic read-modify-write on a 64 bit word.
+ */
+
+#ifndef ATOMICBITS_HPP
+#define ATOMICBITS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+#include "BitKernels.hpp"
+
+namespace cj {
+
+// Class for a shared bit set sized at run time, e.g. a visited map for
+// parallel traversals, methods: test(), test_and_set(), test_and_clear(),
+// high(), low(), flip(), count(), clear(), size(). Bit arguments must be less
+// than size(). count() and clear() are relaxed: they are exact only when no
+// other thread is writing.
+class AtomicBits {
+    std::atomic<uint64_t> *m_set = nullptr;
+    uint64_t m_bits = 0;
+    uint64_t m_length = 0;
+
+    static inline uint64_t mask(const uint64_t bit) {
+        return WORD_ONE << (bit & WORD_MASK);
+    }
+
+    inline std::atomic<uint64_t> &word(const uint64_t bit) const {
+        return m_set[bit >> WORD_SHIFT];
+    }
+
+    // the strongest order valid for a load that order allows, a load can not
+    // release so acq_rel becomes acquire and release becomes relaxed
+    static inline std::memory_order load_order(const std::memory_order order) {
+        switch (order) {
+            case std::memory_order_acq_rel:
+                return std::memory_order_acquire;
+            case std::memory_order_release:
+                return std::memory_order_relaxed;
+            default:
+                return order;
+        }
+    }
+
+   public:
+    // functions to get val in bit^th position
+    inline bool test(const uint64_t bit, const std::memory_order order =
+                                             std::memory_order_acquire) const {
+        return (word(bit).load(order) & mask(bit)) != 0;
+    }
+
+    // function to set bit^th position to 1, returns the previous val. Exactly
+    // one of several threads racing on the same bit sees false. When the bit
+    // is already set only the load is done, with the acquire part of order
+    inline bool test_and_set(const uint64_t bit,
+                             const std::memory_order order =
+                                 std::memory_order_acq_rel) {
+        // skip the write if already set, keeps the cache line shared
+        if (test(bit, load_order(order))) return true;
+        return (word(bit).fetch_or(mask(bit), order) & mask(bit)) != 0;
+    }
+
+    // function to set bit^th position to 0, returns the previous val
+    inline bool test_and_clear(const uint64_t bit,
+                               const std::memory_order order =
+                                   std::memory_order_acq_rel) {
+        return (word(bit).fetch_and(~mask(bit), order) & mask(bit)) != 0;
+    }
+
+    // functions to set val in bit^th position to 1
+    inline void high(const uint64_t bit, const std::memory_order order =
+                                             std::memory_order_release) {
+        word(bit).fetch_or(mask(bit), order);
+    }
+
+    // functions to set val in bit^th position to 0
+    inline void low(const uint64_t bit, const std::memory_order order =
+                                            std::memory_order_release) {
+        word(bit).fetch_and(~mask(bit), order);
+    }
+
+    // functions to swap val in bit^th position
+    inline void flip(const uint64_t bit, const std::memory_order order =
+                                             std::memory_order_release) {
+        word(bit).fetch_xor(mask(bit), order);
+    }
+
+    // function to see how many bits are set to 1 in set
+    uint64_t count(void) const {
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < m_length; ++i) {
+            count += popcount(m_set[i].load(std::memory_order_relaxed));
+        }
+        return count;
+    }
+
+    // function to set every bit to 0
+    void clear(void) {
+        for (uint64_t i = 0; i < m_length; ++i) {
+            m_set[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // return number of bits in the set
+    inline uint64_t size(void) const { return m_bits; }
+
+    // function to print the set on one line one bit at a time
+    void print(void) const {
+        for (uint64_t i = 0; i < m_bits; ++i) {
+            std::cout << test(i, std::memory_order_relaxed);
+        }
+        std::cout << std::endl;
+    }
+
+    // constructor
+    explicit AtomicBits(const uint64_t bits)
+        : m_bits{bits}, m_length{words_for(bits)} {
+        m_set = new std::atomic<uint64_t>[m_length];
+        clear();
+    }
+
+    // de-constructor
+    ~AtomicBits(void) {
+        delete[] m_set;
+        m_set = nullptr;
+    }
+
+    // shared state is not copied
+    AtomicBits(AtomicBits const &other) = delete;
+    AtomicBits &operator=(const AtomicBits &other) = delete;
+
+    // move constructor
+    AtomicBits(AtomicBits &&other) noexcept
+        : m_set{other.m_set}, m_bits{other.m_bits}, m_length{other.m_length} {
+        other.m_set = nullptr;
+        other.m_bits = 0;
+        other.m_length = 0;
+    }
+
+    // move operator
+    AtomicBits &operator=(AtomicBits &&other) noexcept {
+        if (this != &other) {
+            delete[] m_set;
+            m_set = other.m_set;
+            m_bits = other.m_bits;
+            m_length = other.m_length;
+            other.m_set = nullptr;
+            other.m_bits = 0;
+            other.m_length = 0;
+        }
+        return *this;
+    }
+};
+
+}  // namespace cj
+
+#endif  // ATOMICBITS_HPP
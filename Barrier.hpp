@@ -0,0 +1,51 @@
+/**
+ * Barrier.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Reusable thread barrier built on a mutex and a condition variable.
+ */
+
+#ifndef BARRIER_HPP
+#define BARRIER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace cj {
+
+// Class to hold a fixed number of threads until all of them arrive, methods:
+// wait(). Can be waited on again as soon as it releases.
+class Barrier {
+    std::mutex m_lock;
+    std::condition_variable m_cv;
+    const uint32_t m_threads;
+    uint32_t m_waiting = 0;
+    uint64_t m_generation = 0;
+
+   public:
+    // function to block until m_threads threads have called wait()
+    void wait(void) {
+        std::unique_lock<std::mutex> guard(m_lock);
+        const uint64_t generation = m_generation;
+        if (++m_waiting == m_threads) {
+            m_waiting = 0;
+            ++m_generation;
+            m_cv.notify_all();
+        } else {
+            m_cv.wait(guard, [&] { return generation != m_generation; });
+        }
+    }
+
+    // constructor
+    explicit Barrier(const uint32_t threads) : m_threads{threads} {}
+
+    Barrier(Barrier const &other) = delete;
+    Barrier &operator=(const Barrier &other) = delete;
+};
+
+}  // namespace cj
+
+#endif  // BARRIER_HPP
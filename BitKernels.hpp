@@ -0,0 +1,418 @@
+/**
+ * BitKernels.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Loops over arrays of 64 bit words shared by the word based bit sets. Uses
+ * the hardware popcount and, when compiled for them, AVX2 and AVX-512
+ * VPOPCNTDQ. Without those every loop falls back to one word at a time.
+ */
+
+#ifndef BITKERNELS_HPP
+#define BITKERNELS_HPP
+
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace cj {
+
+static const uint32_t WORD_SHIFT = 6;
+static const uint32_t WORD_MASK = 63;
+static const uint64_t WORD_ONE = 1;
+
+// number of words needed to hold bits
+constexpr uint64_t words_for(const uint64_t bits) {
+    return (bits >> WORD_SHIFT) + ((bits & WORD_MASK) != 0);
+}
+
+// mask of the valid bits in the last word of a set of length bits
+constexpr uint64_t tail_mask(const uint64_t bits) {
+    return (bits & WORD_MASK) ? (WORD_ONE << (bits & WORD_MASK)) - 1 : ~0ULL;
+}
+
+// number of bits set to one in a word
+inline uint32_t popcount(const uint64_t word) {
+    return static_cast<uint32_t>(__builtin_popcountll(word));
+}
+
+#ifdef __AVX2__
+// unaligned load of four words
+inline __m256i load4(const uint64_t *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+// unaligned store of four words
+inline void store4(uint64_t *p, const __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+}
+
+// number of bits set to one in each 64 bit lane of v
+inline __m256i popcount_lanes(const __m256i v) {
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512VL__)
+    return _mm256_popcnt_epi64(v);
+#else
+    // nibble lookup with pshufb then sum bytes per lane (W. Mula)
+    const __m256i lookup =
+        _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                         1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, nibble);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                    _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+#endif
+}
+
+// sum of the four 64 bit lanes of v
+inline uint64_t sum_lanes(const __m256i v) {
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(s)) +
+           static_cast<uint64_t>(_mm_extract_epi64(s, 1));
+}
+#endif  // __AVX2__
+
+// number of bits set to one in n words
+inline uint64_t popcount_words(const uint64_t *words, const uint64_t n) {
+    uint64_t count = 0;
+    uint64_t i = 0;
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    __m512i acc = _mm512_setzero_si512();
+    for (const uint64_t end = n & ~7ULL; i < end; i += 8) {
+        __m512i v = _mm512_loadu_si512(words + i);
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+    }
+    // sum the lanes by hand, the reduce and extract intrinsics warn on GCC
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512(lanes, acc);
+    for (uint32_t k = 0; k < 8; ++k) count += lanes[k];
+#elif defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (const uint64_t end = n & ~3ULL; i < end; i += 4) {
+        __m256i v = load4(words + i);
+        acc = _mm256_add_epi64(acc, popcount_lanes(v));
+    }
+    count = sum_lanes(acc);
+#endif
+    for (; i < n; ++i) {
+        count += popcount(words[i]);
+    }
+    return count;
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Binary operations between words, each has a scalar word() and a vector
+// simd() version
+
+struct OpAnd {
+    static inline uint64_t word(uint64_t a, uint64_t b) { return a & b; }
+#ifdef __AVX2__
+    static inline __m256i simd(__m256i a, __m256i b) {
+        return _mm256_and_si256(a, b);
+    }
+#endif
+};
+
+struct OpOr {
+    static inline uint64_t word(uint64_t a, uint64_t b) { return a | b; }
+#ifdef __AVX2__
+    static inline __m256i simd(__m256i a, __m256i b) {
+        return _mm256_or_si256(a, b);
+    }
+#endif
+};
+
+struct OpXor {
+    static inline uint64_t word(uint64_t a, uint64_t b) { return a ^ b; }
+#ifdef __AVX2__
+    static inline __m256i simd(__m256i a, __m256i b) {
+        return _mm256_xor_si256(a, b);
+    }
+#endif
+};
+
+// a and not b
+struct OpAndNot {
+    static inline uint64_t word(uint64_t a, uint64_t b) { return a & ~b; }
+#ifdef __AVX2__
+    static inline __m256i simd(__m256i a, __m256i b) {
+        return _mm256_andnot_si256(b, a);
+    }
+#endif
+};
+
+// dst[i] = Op(a[i], b[i]) for n words, dst may alias a or b
+template <class Op>
+inline void apply_words(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+                        const uint64_t n) {
+    uint64_t i = 0;
+#ifdef __AVX2__
+    for (const uint64_t end = n & ~3ULL; i < end; i += 4) {
+        __m256i x = load4(a + i);
+        __m256i y = load4(b + i);
+        store4(dst + i, Op::simd(x, y));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = Op::word(a[i], b[i]);
+    }
+}
+
+// dst[i] = ~a[i] for n words, dst may alias a
+inline void not_words(uint64_t *dst, const uint64_t *a, const uint64_t n) {
+    uint64_t i = 0;
+#ifdef __AVX2__
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    for (const uint64_t end = n & ~3ULL; i < end; i += 4) {
+        __m256i x = load4(a + i);
+        store4(dst + i, _mm256_xor_si256(x, ones));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = ~a[i];
+    }
+}
+
+// popcount(Op(a, b)) over n words without storing the result
+template <class Op>
+inline uint64_t count_words(const uint64_t *a, const uint64_t *b,
+                            const uint64_t n) {
+    uint64_t count = 0;
+    uint64_t i = 0;
+#ifdef __AVX2__
+    __m256i acc = _mm256_setzero_si256();
+    for (const uint64_t end = n & ~3ULL; i < end; i += 4) {
+        __m256i x = load4(a + i);
+        __m256i y = load4(b + i);
+        acc = _mm256_add_epi64(acc, popcount_lanes(Op::simd(x, y)));
+    }
+    count = sum_lanes(acc);
+#endif
+    for (; i < n; ++i) {
+        count += popcount(Op::word(a[i], b[i]));
+    }
+    return count;
+}
+
+/*----------------------------------------------------------------------------*/
+
+// index of the lowest set bit in a non zero word
+inline uint32_t lowest(const uint64_t word) {
+    return static_cast<uint32_t>(__builtin_ctzll(word));
+}
+
+// index of the k^th (counting from 0) bit set to 1 in word, word must have
+// more than k bits set
+inline uint32_t select_word(uint64_t word, uint32_t k) {
+#ifdef __BMI2__
+    return lowest(_pdep_u64(WORD_ONE << k, word));
+#else
+    for (; k != 0; --k) {
+        word &= word - 1;
+    }
+    return lowest(word);
+#endif
+}
+
+// index of the first bit set to 1 at or after bit in n words, n * 64 if none
+inline uint64_t find_words(const uint64_t *words, const uint64_t n,
+                           const uint64_t bit) {
+    uint64_t w = bit >> WORD_SHIFT;
+    if (w >= n) return n << WORD_SHIFT;
+    uint64_t word = words[w] & (~0ULL << (bit & WORD_MASK));
+    while (word == 0) {
+        if (++w == n) return n << WORD_SHIFT;
+        word = words[w];
+    }
+    return (w << WORD_SHIFT) + lowest(word);
+}
+
+// index of the first bit set to 0 at or after bit in n words, n * 64 if none
+inline uint64_t find_zero_words(const uint64_t *words, const uint64_t n,
+                                const uint64_t bit) {
+    uint64_t w = bit >> WORD_SHIFT;
+    if (w >= n) return n << WORD_SHIFT;
+    uint64_t word = ~words[w] & (~0ULL << (bit & WORD_MASK));
+    while (word == 0) {
+        if (++w == n) return n << WORD_SHIFT;
+        word = ~words[w];
+    }
+    return (w << WORD_SHIFT) + lowest(word);
+}
+
+// Forward iterator over the indices of the bits set to 1 in n words. Whole
+// zero words are skipped and each step clears the lowest set bit (blsr).
+class OnesIterator {
+    const uint64_t *m_words = nullptr;
+    uint64_t m_n = 0;
+    uint64_t m_w = 0;
+    uint64_t m_word = 0;
+
+    // move to the next non zero word
+    inline void skip(void) {
+        while (m_word == 0 && ++m_w < m_n) {
+            m_word = m_words[m_w];
+        }
+    }
+
+   public:
+    OnesIterator(const uint64_t *words, const uint64_t n, const uint64_t w)
+        : m_words{words}, m_n{n}, m_w{w} {
+        if (m_w < m_n) {
+            m_word = m_words[m_w];
+            skip();
+        }
+    }
+
+    inline uint64_t operator*(void) const {
+        return (m_w << WORD_SHIFT) + lowest(m_word);
+    }
+
+    inline OnesIterator &operator++(void) {
+        m_word &= m_word - 1;
+        skip();
+        return *this;
+    }
+
+    inline bool operator==(const OnesIterator &other) const {
+        return m_w == other.m_w && m_word == other.m_word;
+    }
+
+    inline bool operator!=(const OnesIterator &other) const {
+        return !(*this == other);
+    }
+};
+
+// range of the set bits in n words for use in range based for loops
+class OnesRange {
+    const uint64_t *m_words;
+    uint64_t m_n;
+
+   public:
+    OnesRange(const uint64_t *words, const uint64_t n)
+        : m_words{words}, m_n{n} {}
+
+    inline OnesIterator begin(void) const {
+        return OnesIterator(m_words, m_n, 0);
+    }
+    inline OnesIterator end(void) const {
+        return OnesIterator(m_words, m_n, m_n);
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Shifts and rotations of n words as one long bit string. Left moves bit i to
+// bit i + k, like << on an integer.
+
+// the 64 bits of n words starting at bit, bits outside the words read as 0
+inline uint64_t bits_at(const uint64_t *words, const uint64_t n,
+                        const int64_t bit) {
+    if (bit <= -64) return 0;
+    if (bit < 0) return words[0] << -bit;
+    const uint64_t w = static_cast<uint64_t>(bit) >> WORD_SHIFT;
+    const uint32_t o = bit & WORD_MASK;
+    uint64_t out = w < n ? words[w] >> o : 0;
+    if (o != 0 && w + 1 < n) out |= words[w + 1] << (64 - o);
+    return out;
+}
+
+// dst = src << k over n words, zero filled, dst may alias src
+inline void shl_words(uint64_t *dst, const uint64_t *src, const uint64_t n,
+                      const uint64_t k) {
+    for (uint64_t w = n; w-- > 0;) {
+        dst[w] = bits_at(src, n, static_cast<int64_t>(w << WORD_SHIFT) -
+                                     static_cast<int64_t>(k));
+    }
+}
+
+// dst = src >> k over n words, zero filled, dst may alias src
+inline void shr_words(uint64_t *dst, const uint64_t *src, const uint64_t n,
+                      const uint64_t k) {
+    for (uint64_t w = 0; w < n; ++w) {
+        dst[w] = bits_at(src, n, static_cast<int64_t>((w << WORD_SHIFT) + k));
+    }
+}
+
+// dst = src rotated left by k within a string of bits bits, bit i moves to
+// (i + k) % bits. src must be 0 past bits and dst must not alias src.
+inline void rotl_words(uint64_t *dst, const uint64_t *src, const uint64_t bits,
+                       uint64_t k) {
+    const uint64_t n = words_for(bits);
+    if (n == 0) return;
+    k %= bits;
+    for (uint64_t w = 0; w < n; ++w) {
+        const int64_t at = static_cast<int64_t>(w << WORD_SHIFT);
+        dst[w] = bits_at(src, n, at - static_cast<int64_t>(k)) |
+                 bits_at(src, n, at + static_cast<int64_t>(bits - k));
+    }
+    dst[n - 1] &= tail_mask(bits);
+}
+
+// dst = src rotated right by k within a string of bits bits
+inline void rotr_words(uint64_t *dst, const uint64_t *src, const uint64_t bits,
+                       const uint64_t k) {
+    if (bits != 0) rotl_words(dst, src, bits, bits - k % bits);
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Bit sliced adders, treat bit j of each input word as a separate number so
+// one call adds 64 columns at once. Outputs are bit planes, s0 is the 1s bit.
+
+// s0 = a + b + c mod 2, s1 = carry
+inline void full_add(const uint64_t a, const uint64_t b, const uint64_t c,
+                     uint64_t &s0, uint64_t &s1) {
+    const uint64_t t = a ^ b;
+    s0 = t ^ c;
+    s1 = (a & b) | (t & c);
+}
+
+// s0 = a + b mod 2, s1 = carry
+inline void half_add(const uint64_t a, const uint64_t b, uint64_t &s0,
+                     uint64_t &s1) {
+    s0 = a ^ b;
+    s1 = a & b;
+}
+
+// sum of 4 words per bit, 0 to 4, e.g. the neighbours of a square lattice
+inline void add4(const uint64_t a, const uint64_t b, const uint64_t c,
+                 const uint64_t d, uint64_t &s0, uint64_t &s1, uint64_t &s2) {
+    uint64_t t, c0, c1;
+    full_add(a, b, c, t, c0);
+    half_add(t, d, s0, c1);
+    half_add(c0, c1, s1, s2);
+}
+
+// sum of 6 words per bit, 0 to 6, e.g. the neighbours of a cubic lattice
+inline void add6(const uint64_t (&n)[6], uint64_t &s0, uint64_t &s1,
+                 uint64_t &s2) {
+    uint64_t x0, y0, x1, y1, z;
+    full_add(n[0], n[1], n[2], x0, y0);
+    full_add(n[3], n[4], n[5], x1, y1);
+    half_add(x0, x1, s0, z);
+    full_add(y0, y1, z, s1, s2);
+}
+
+// sum of 8 words per bit, 0 to 8, e.g. the Moore neighbourhood
+inline void add8(const uint64_t (&n)[8], uint64_t &s0, uint64_t &s1,
+                 uint64_t &s2, uint64_t &s3) {
+    uint64_t x0, y0, x1, y1, x2, y2, z, t, u, v;
+    full_add(n[0], n[1], n[2], x0, y0);
+    full_add(n[3], n[4], n[5], x1, y1);
+    half_add(n[6], n[7], x2, y2);
+    full_add(x0, x1, x2, s0, z);
+    full_add(y0, y1, y2, t, u);
+    half_add(t, z, s1, v);
+    half_add(u, v, s2, s3);
+}
+
+}  // namespace cj
+
+#endif  // BITKERNELS_HPP
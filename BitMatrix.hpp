@@ -0,0 +1,248 @@
+/**
+ * BitMatrix.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Dense matrix of bits with word packed rows in one allocation. Supports a
+ * cache blocked transpose built on a 64x64 bit kernel, matrix-vector products
+ * over GF(2) and row and column popcounts.
+ */
+
+#ifndef BITMATRIX_HPP
+#define BITMATRIX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "BitKernels.hpp"
+#include "DenseBits.hpp"
+
+namespace cj {
+
+// function to transpose a 64x64 bit block in place, bit c of word r moves to
+// bit r of word c. Swaps 32x32 sub-blocks then 16x16 and so on down to 1x1
+// (Hacker's Delight 7-3).
+inline void transpose64(uint64_t (&a)[64]) {
+    uint64_t m = 0x00000000FFFFFFFFULL;
+    for (uint32_t j = 32; j != 0; j >>= 1, m ^= m << j) {
+        for (uint32_t k = 0; k < 64; k = (k + j + 1) & ~j) {
+            uint64_t t = ((a[k] >> j) ^ a[k + j]) & m;
+            a[k] ^= t << j;
+            a[k + j] ^= t;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Class for a rows x cols matrix of bits, each row is stride() words and bits
+// past cols are kept at 0. Storage is padded to a multiple of 64 rows so the
+// transpose kernel never needs bounds checks. Methods: test(), high(), low(),
+// flip(), row(), set_row(), count(), row_count(), col_counts(), transpose(),
+// mul(), from(), print().
+class BitMatrix {
+    uint64_t m_rows = 0;
+    uint64_t m_cols = 0;
+    uint64_t m_stride = 0;
+    uint64_t *m_data = nullptr;
+
+    inline uint64_t padded_rows(void) const { return words_for(m_rows) * 64; }
+
+    inline void alloc(void) {
+        m_stride = words_for(m_cols);
+        m_data = new uint64_t[padded_rows() * m_stride]();
+    }
+
+   public:
+    // return shape of matrix
+    inline uint64_t rows(void) const { return m_rows; }
+    inline uint64_t cols(void) const { return m_cols; }
+    inline uint64_t stride(void) const { return m_stride; }
+
+    // return pointer to the words of row i
+    inline uint64_t *row(const uint64_t i) { return m_data + i * m_stride; }
+    inline const uint64_t *row(const uint64_t i) const {
+        return m_data + i * m_stride;
+    }
+
+    // functions to get val in i,j position
+    inline bool test(const uint64_t i, const uint64_t j) const {
+        return (row(i)[j >> WORD_SHIFT] >> (j & WORD_MASK)) & WORD_ONE;
+    }
+
+    // functions to set val in i,j position to 1
+    inline void high(const uint64_t i, const uint64_t j) {
+        row(i)[j >> WORD_SHIFT] |= WORD_ONE << (j & WORD_MASK);
+    }
+
+    // functions to set val in i,j position to 0
+    inline void low(const uint64_t i, const uint64_t j) {
+        row(i)[j >> WORD_SHIFT] &= ~(WORD_ONE << (j & WORD_MASK));
+    }
+
+    // functions to swap val in i,j position
+    inline void flip(const uint64_t i, const uint64_t j) {
+        row(i)[j >> WORD_SHIFT] ^= WORD_ONE << (j & WORD_MASK);
+    }
+
+    // function to copy stride() words into row i
+    inline void set_row(const uint64_t i, const uint64_t *words) {
+        std::copy(words, words + m_stride, row(i));
+        row(i)[m_stride - 1] &= tail_mask(m_cols);
+    }
+
+    // function to copy a word bit set of cols() bits into row i
+    template <class E>
+    inline void set_row(const uint64_t i, const WordBits<E> &bits) {
+        set_row(i, static_cast<E const &>(bits).words());
+    }
+
+    // function to see how many bits are set to 1 in row i
+    inline uint64_t row_count(const uint64_t i) const {
+        return popcount_words(row(i), m_stride);
+    }
+
+    // function to see how many bits are set to 1 in the matrix
+    inline uint64_t count(void) const {
+        return popcount_words(m_data, m_rows * m_stride);
+    }
+
+    // function to count the bits set in each column, transposes one 64x64
+    // block at a time and popcounts its words
+    std::vector<uint64_t> col_counts(void) const {
+        std::vector<uint64_t> counts(m_stride * 64, 0);
+        uint64_t block[64];
+        for (uint64_t bi = 0; bi < words_for(m_rows); ++bi) {
+            for (uint64_t bj = 0; bj < m_stride; ++bj) {
+                for (uint32_t r = 0; r < 64; ++r) {
+                    block[r] = m_data[(bi * 64 + r) * m_stride + bj];
+                }
+                transpose64(block);
+                for (uint32_t c = 0; c < 64; ++c) {
+                    counts[bj * 64 + c] += popcount(block[c]);
+                }
+            }
+        }
+        counts.resize(m_cols);
+        return counts;
+    }
+
+    // function to build the cols x rows transpose, one 64x64 block at a time
+    BitMatrix transpose(void) const {
+        BitMatrix out(m_cols, m_rows);
+        uint64_t block[64];
+        for (uint64_t bi = 0; bi < words_for(m_rows); ++bi) {
+            for (uint64_t bj = 0; bj < m_stride; ++bj) {
+                for (uint32_t r = 0; r < 64; ++r) {
+                    block[r] = m_data[(bi * 64 + r) * m_stride + bj];
+                }
+                transpose64(block);
+                for (uint32_t c = 0; c < 64; ++c) {
+                    out.m_data[(bj * 64 + c) * out.m_stride + bi] = block[c];
+                }
+            }
+        }
+        return out;
+    }
+
+    // function to multiply the cols() bit vector x over GF(2), bit i of the
+    // result is the parity of row i and x
+    DynamicBits mul(const DynamicBits &x) const {
+        if (x.size() != m_cols) {
+            throw invalid_argument("Vector length must equal cols");
+        }
+        DynamicBits y(m_rows);
+        for (uint64_t i = 0; i < m_rows; ++i) {
+            y.assign(i, count_words<OpAnd>(row(i), x.words(), m_stride) & 1);
+        }
+        return y;
+    }
+
+    // function to pack any grid with test(i, j), e.g. an IsingArray, into a
+    // rows x cols matrix
+    template <class G>
+    static BitMatrix from(const G &grid, const uint64_t rows,
+                          const uint64_t cols) {
+        BitMatrix out(rows, cols);
+        for (uint64_t i = 0; i < rows; ++i) {
+            uint64_t *words = out.row(i);
+            for (uint64_t j = 0; j < cols; ++j) {
+                words[j >> WORD_SHIFT] |=
+                    static_cast<uint64_t>(grid.test(i, j) != 0)
+                    << (j & WORD_MASK);
+            }
+        }
+        return out;
+    }
+
+    // function to print the matrix one row per line
+    void print(void) const {
+        for (uint64_t i = 0; i < m_rows; ++i) {
+            for (uint64_t j = 0; j < m_cols; ++j) {
+                cout << test(i, j);
+            }
+            cout << "\n";
+        }
+        cout << endl;
+    }
+
+    // constructor
+    BitMatrix(const uint64_t rows, const uint64_t cols)
+        : m_rows{rows}, m_cols{cols} {
+        alloc();
+    }
+
+    // de-constructor
+    ~BitMatrix(void) {
+        delete[] m_data;
+        m_data = nullptr;
+    }
+
+    // copy constructor for functions
+    BitMatrix(BitMatrix const &other)
+        : m_rows{other.m_rows}, m_cols{other.m_cols} {
+        alloc();
+        std::copy(other.m_data, other.m_data + padded_rows() * m_stride,
+                  m_data);
+    }
+
+    // move constructor
+    BitMatrix(BitMatrix &&other) noexcept
+        : m_rows{other.m_rows},
+          m_cols{other.m_cols},
+          m_stride{other.m_stride},
+          m_data{other.m_data} {
+        other.m_data = nullptr;
+        other.m_rows = other.m_cols = other.m_stride = 0;
+    }
+
+    // assignment operator
+    BitMatrix &operator=(const BitMatrix &other) {
+        if (this != &other) {
+            BitMatrix tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    // move operator
+    BitMatrix &operator=(BitMatrix &&other) noexcept {
+        if (this != &other) {
+            delete[] m_data;
+            m_rows = other.m_rows;
+            m_cols = other.m_cols;
+            m_stride = other.m_stride;
+            m_data = other.m_data;
+            other.m_data = nullptr;
+            other.m_rows = other.m_cols = other.m_stride = 0;
+        }
+        return *this;
+    }
+};
+
+}  // namespace cj
+
+#endif  // BITMATRIX_HPP
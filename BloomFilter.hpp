@@ -0,0 +1,297 @@
+/**
+ * BloomFilter.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Probabilistic set membership for uint32_t keys, e.g. to skip RobinHash
+ * lookups for keys that are not in the table. BloomFilter is the textbook
+ * filter on a DynamicBits. BlockedBloom puts all 8 probes of a key in one
+ * 512 bit (cache line) block, one bit per word, so a query touches a single
+ * cache line and with AVX2 is tested with two vector instructions.
+ */
+
+#ifndef BLOOMFILTER_HPP
+#define BLOOMFILTER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include "BitKernels.hpp"
+#include "DenseBits.hpp"
+#include "MurmurHash3.hpp"
+
+namespace cj {
+
+// maps a 64 bit hash uniformly onto [0, n) without a division (D. Lemire)
+inline uint64_t fast_range(const uint64_t hash, const uint64_t n) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * n) >>
+                                 64);
+}
+
+// 128 bit hash of a key as two 64 bit halves
+inline void hash128(const uint32_t key, uint64_t (&out)[2]) {
+    MurmurHash3_x64_128(&key, 4, 0, out);
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Class for a standard Bloom filter with k probes spread over the whole set
+// using double hashing, methods: insert(), contains(), clear(), bits(),
+// probes(), fill().
+class BloomFilter {
+    DynamicBits m_set;
+    uint32_t m_k;
+
+   public:
+    // function to add key to the filter
+    inline void insert(const uint32_t key) {
+        uint64_t h[2];
+        hash128(key, h);
+        for (uint32_t i = 0; i < m_k; ++i) {
+            m_set.high(fast_range(h[0] + i * h[1], m_set.size()));
+        }
+    }
+
+    // function to test for key, false means definitely not inserted
+    inline bool contains(const uint32_t key) const {
+        uint64_t h[2];
+        hash128(key, h);
+        for (uint32_t i = 0; i < m_k; ++i) {
+            if (!m_set.test(fast_range(h[0] + i * h[1], m_set.size()))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // function to empty the filter
+    inline void clear(void) { m_set.clear(); }
+
+    // return number of bits in the filter
+    inline uint64_t bits(void) const { return m_set.size(); }
+
+    // return number of probes per key
+    inline uint32_t probes(void) const { return m_k; }
+
+    // return fraction of bits set, the false positive rate is about fill^k
+    inline double fill(void) const {
+        return static_cast<double>(m_set.count()) / m_set.size();
+    }
+
+    // constructor for about expected keys with false positive rate fpr
+    BloomFilter(const uint64_t expected, const double fpr) {
+        if (expected == 0 || fpr <= 0 || fpr >= 1) {
+            throw std::invalid_argument("Need expected > 0 and 0 < fpr < 1");
+        }
+        const double ln2 = std::log(2.0);
+        double bits = -static_cast<double>(expected) * std::log(fpr) /
+                      (ln2 * ln2);
+        m_set = DynamicBits(std::max<uint64_t>(64, std::ceil(bits)));
+        m_k = std::max<uint32_t>(
+            1, std::lround(bits / static_cast<double>(expected) * ln2));
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+static const uint32_t BLOOM_BLOCK_WORDS = 8;  // 512 bit blocks
+static const uint32_t BLOOM_BATCH = 16;       // keys hashed ahead in batches
+
+// odd multipliers choosing each probe's bit from one hash (Apache Impala)
+static const uint32_t BLOOM_SALT[BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+// Class for a cache blocked Bloom filter with 8 probes per key, methods:
+// insert(), contains() for single keys or batches, clear(), bits(), fill().
+// About 12 bits per key gives a false positive rate near 0.5%.
+class BlockedBloom {
+    uint64_t *m_raw = nullptr;
+    uint64_t *m_blocks = nullptr;  // 64 byte aligned into m_raw
+    uint64_t m_n_blocks = 0;
+
+    // split a key's hash into its block and the 32 bits choosing its probes
+    inline uint64_t *locate(const uint32_t key, uint32_t &probe) const {
+        uint64_t h[2];
+        hash128(key, h);
+        probe = static_cast<uint32_t>(h[1]);
+        return m_blocks + BLOOM_BLOCK_WORDS * fast_range(h[0], m_n_blocks);
+    }
+
+#ifdef __AVX2__
+    // the masks for words 0-3 and 4-7 of a block
+    static inline void masks(const uint32_t probe, __m256i &lo, __m256i &hi) {
+        const __m256i salt = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(BLOOM_SALT));
+        __m256i shift = _mm256_srli_epi32(
+            _mm256_mullo_epi32(_mm256_set1_epi32(probe), salt), 26);
+        const __m256i one = _mm256_set1_epi64x(1);
+        lo = _mm256_sllv_epi64(
+            one, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(shift)));
+        hi = _mm256_sllv_epi64(
+            one, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(shift, 1)));
+    }
+#endif
+
+    // the bit probe i sets in word i of a block
+    static inline uint64_t mask(const uint32_t probe, const uint32_t i) {
+        return WORD_ONE << ((probe * BLOOM_SALT[i]) >> 26);
+    }
+
+    static inline void set_block(uint64_t *block, const uint32_t probe) {
+#ifdef __AVX2__
+        __m256i lo, hi;
+        masks(probe, lo, hi);
+        store4(block, _mm256_or_si256(load4(block), lo));
+        store4(block + 4, _mm256_or_si256(load4(block + 4), hi));
+#else
+        for (uint32_t i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+            block[i] |= mask(probe, i);
+        }
+#endif
+    }
+
+    static inline bool test_block(const uint64_t *block, const uint32_t probe) {
+#ifdef __AVX2__
+        __m256i lo, hi;
+        masks(probe, lo, hi);
+        return _mm256_testc_si256(load4(block), lo) &
+               _mm256_testc_si256(load4(block + 4), hi);
+#else
+        uint64_t miss = 0;
+        for (uint32_t i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+            miss |= mask(probe, i) & ~block[i];
+        }
+        return miss == 0;
+#endif
+    }
+
+    // allocate zeroed storage for m_n_blocks blocks aligned to 64 bytes
+    inline void alloc(void) {
+        m_raw = new uint64_t[BLOOM_BLOCK_WORDS * (m_n_blocks + 1)]();
+        uintptr_t addr = reinterpret_cast<uintptr_t>(m_raw);
+        m_blocks = reinterpret_cast<uint64_t *>((addr + 63) & ~uintptr_t(63));
+    }
+
+   public:
+    // function to add key to the filter
+    inline void insert(const uint32_t key) {
+        uint32_t probe;
+        uint64_t *block = locate(key, probe);
+        set_block(block, probe);
+    }
+
+    // function to add n keys to the filter
+    void insert(const uint32_t *keys, const uint64_t n) {
+        uint64_t *block[BLOOM_BATCH];
+        uint32_t probe[BLOOM_BATCH];
+        for (uint64_t i = 0; i < n; i += BLOOM_BATCH) {
+            const uint64_t m = std::min<uint64_t>(BLOOM_BATCH, n - i);
+            for (uint64_t j = 0; j < m; ++j) {
+                block[j] = locate(keys[i + j], probe[j]);
+                __builtin_prefetch(block[j], 1);
+            }
+            for (uint64_t j = 0; j < m; ++j) {
+                set_block(block[j], probe[j]);
+            }
+        }
+    }
+
+    // function to test for key, false means definitely not inserted
+    inline bool contains(const uint32_t key) const {
+        uint32_t probe;
+        const uint64_t *block = locate(key, probe);
+        return test_block(block, probe);
+    }
+
+    // function to test n keys writing the answers to out, hashes a batch of
+    // keys and prefetches their blocks before testing any of them
+    void contains(const uint32_t *keys, const uint64_t n, bool *out) const {
+        const uint64_t *block[BLOOM_BATCH];
+        uint32_t probe[BLOOM_BATCH];
+        for (uint64_t i = 0; i < n; i += BLOOM_BATCH) {
+            const uint64_t m = std::min<uint64_t>(BLOOM_BATCH, n - i);
+            for (uint64_t j = 0; j < m; ++j) {
+                block[j] = locate(keys[i + j], probe[j]);
+                __builtin_prefetch(block[j]);
+            }
+            for (uint64_t j = 0; j < m; ++j) {
+                out[i + j] = test_block(block[j], probe[j]);
+            }
+        }
+    }
+
+    // function to empty the filter
+    inline void clear(void) {
+        std::fill(m_blocks, m_blocks + BLOOM_BLOCK_WORDS * m_n_blocks, 0);
+    }
+
+    // return number of bits in the filter
+    inline uint64_t bits(void) const { return 512 * m_n_blocks; }
+
+    // return fraction of bits set
+    inline double fill(void) const {
+        return static_cast<double>(popcount_words(
+                   m_blocks, BLOOM_BLOCK_WORDS * m_n_blocks)) /
+               bits();
+    }
+
+    // constructor for about expected keys using bits_per_key bits each
+    explicit BlockedBloom(const uint64_t expected,
+                          const double bits_per_key = 12) {
+        if (expected == 0 || bits_per_key <= 0) {
+            throw std::invalid_argument("Need expected, bits_per_key > 0");
+        }
+        m_n_blocks = std::max<uint64_t>(
+            1, std::ceil(expected * bits_per_key / 512));
+        alloc();
+    }
+
+    // de-constructor
+    ~BlockedBloom(void) {
+        delete[] m_raw;
+        m_raw = nullptr;
+        m_blocks = nullptr;
+    }
+
+    // copy constructor for functions
+    BlockedBloom(BlockedBloom const &other) : BlockedBloom(1) {
+        *this = other;
+    }
+
+    // assignment operator
+    BlockedBloom &operator=(const BlockedBloom &other) {
+        if (this != &other) {
+            if (m_n_blocks != other.m_n_blocks) {
+                delete[] m_raw;
+                m_n_blocks = other.m_n_blocks;
+                alloc();
+            }
+            std::copy(other.m_blocks,
+                      other.m_blocks + BLOOM_BLOCK_WORDS * m_n_blocks,
+                      m_blocks);
+        }
+        return *this;
+    }
+
+    // move operator
+    BlockedBloom &operator=(BlockedBloom &&other) noexcept {
+        if (this != &other) {
+            delete[] m_raw;
+            m_raw = other.m_raw;
+            m_blocks = other.m_blocks;
+            m_n_blocks = other.m_n_blocks;
+            other.m_raw = nullptr;
+            other.m_blocks = nullptr;
+            other.m_n_blocks = 0;
+        }
+        return *this;
+    }
+};
+
+}  // namespace cj
+
+#endif  // BLOOMFILTER_HPP
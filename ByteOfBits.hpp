@@ -5,6 +5,14 @@
 #include <iostream>
 #include <stdexcept>
 
+#ifdef CHECK_ON
+#include "comforts.hpp"  // ASSERT
+#endif
+
+#ifndef ASSERT
+#define ASSERT(x, message) ((void)0)
+#endif
+
 using std::cout;
 using std::endl;
 using std::invalid_argument;
@@ -12,35 +20,73 @@ using std::uint8_t;
 
 namespace cj {
 
+// Class to access each bit stored in a byte separately, methods:
+// test(), high(), low(), flip(), assign(), count(), print(), data() and the
+// older get(), set(). Every access is a shift and a mask, bit must be in
+// [0, 8) and val in {0, 1}, checked only when compiled with CHECK_ON.
 class ByteOfBits {
- public:
   uint8_t byte = 0;
 
-  // function to set bit to val
-  inline void set(const uint8_t bit, const uint8_t val) {
-    if (val != 0 && val != 1) throw invalid_argument("val must be 0 or 1");
-    if (bit > 7) throw invalid_argument("must be 0<=x<=7");
-    if (val == ((byte >> bit) & 1)) {  // ((byte & (1 << bit)) >> bit))
-      return;
-    } else {
-      byte = byte ^ (1 << bit);
-      return;
-    }
+  static constexpr uint8_t mask(const uint8_t bit) noexcept {
+    return static_cast<uint8_t>(1U << bit);
   }
 
-  // functions to get val in bit
-  inline bool get(const uint8_t bit) {
-    if (bit > 7) throw invalid_argument("must be 0<=x<=7");
+ public:
+  // functions to get val in bit^th position
+  constexpr bool test(const uint8_t bit) const noexcept {
+    ASSERT(bit < 8, "must be 0<=x<=7");
     return (byte >> bit) & 1;
   }
 
-  inline void print(void) {
+  // functions to set val in bit^th position to 1
+  constexpr void high(const uint8_t bit) noexcept {
+    ASSERT(bit < 8, "must be 0<=x<=7");
+    byte |= mask(bit);
+  }
+
+  // functions to set val in bit^th position to 0
+  constexpr void low(const uint8_t bit) noexcept {
+    ASSERT(bit < 8, "must be 0<=x<=7");
+    byte &= static_cast<uint8_t>(~mask(bit));
+  }
+
+  // functions to swap val in bit^th position
+  constexpr void flip(const uint8_t bit) noexcept {
+    ASSERT(bit < 8, "must be 0<=x<=7");
+    byte ^= mask(bit);
+  }
+
+  // function to set bit^th position to val without branching
+  constexpr void assign(const uint8_t bit, const uint8_t val) noexcept {
+    ASSERT(bit < 8, "must be 0<=x<=7");
+    ASSERT(val == 0 || val == 1, "val must be 0 or 1");
+    byte ^= static_cast<uint8_t>((-val ^ byte) & mask(bit));
+  }
+
+  // aliases used by RobinHash
+  constexpr bool get(const uint8_t bit) const noexcept { return test(bit); }
+  constexpr void set(const uint8_t bit, const uint8_t val) noexcept {
+    assign(bit, val);
+  }
+
+  // function to see how many bits are set to 1 in byte
+  constexpr uint8_t count(void) const noexcept {
+    return static_cast<uint8_t>(__builtin_popcount(byte));
+  }
+
+  constexpr uint8_t data(void) const noexcept { return byte; }
+
+  // function to print the byte on one line one bit at a time
+  void print(const bool endline = true) const {
     for (int i = 0; i < 8; ++i) {
-      cout << get(i) << ", ";
+      cout << test(i) << ", ";
     }
-    cout << endl;
+    if (endline) cout << endl;
     return;
   }
+
+  constexpr ByteOfBits(void) noexcept = default;
+  constexpr explicit ByteOfBits(const uint8_t val) noexcept : byte{val} {}
 };
 
 }  // namespace cj
@@ -4,8 +4,9 @@
  * Copyright (c) 2019, C. J. Williams
  * All rights reserved.
  *
- * A collection of dense bit representations, ByteOfBits for 8 bits and
- * DenseBits for N bits.
+ * A collection of dense bit representations, DenseBitsH for N bits stored in
+ * ByteOfBits, DenseBitsW and DenseBitsS for N bits stored in 64 bit words on
+ * the heap or inline and DynamicBits for a number of bits chosen at run time.
  */
 
 #ifndef BITSETS_HPP
@@ -15,7 +16,8 @@
 #include <iostream>
 #include <stdexcept>
 
-#include "BitsSetTable256.hpp"  //lookup table
+#include "BitKernels.hpp"  //word loops
+#include "ByteOfBits.hpp"  //byte access
 
 namespace cj {
 
@@ -24,158 +26,12 @@ using std::cout;
 using std::endl;
 using std::invalid_argument;
 
-static const unsigned char ONE = 1;
-static const unsigned char MAX = 255;
 static const unsigned MASK = 7;
 
 static const char PRINTER[] = {'0', '1', ','};
 
 /*----------------------------------------------------------------------------*/
 
-// Class to access each bit stored in a byte separately, methods:
-// test(), flip(), high(), low(), print(), count()
-class ByteOfBits {
-    unsigned char byte = 0;
-
-   public:
-    // functions to get val in bit^th position
-    const bool test(const unsigned char bit) {
-        switch (bit) {
-            case 0:
-                return (byte >> 0) & ONE;
-            case 1:
-                return (byte >> 1) & ONE;
-            case 2:
-                return (byte >> 2) & ONE;
-            case 3:
-                return (byte >> 3) & ONE;
-            case 4:
-                return (byte >> 4) & ONE;
-            case 5:
-                return (byte >> 5) & ONE;
-            case 6:
-                return (byte >> 6) & ONE;
-            case 7:
-                return (byte >> 7) & ONE;
-            default:
-                throw invalid_argument("Fallen through switch in test()");
-        }
-    }
-
-    // functions to set val in bit^th position to 1
-    void high(const unsigned char bit) {
-        switch (bit) {
-            case 0:
-                byte |= (ONE << 0);
-                return;
-            case 1:
-                byte |= (ONE << 1);
-                return;
-            case 2:
-                byte |= (ONE << 2);
-                return;
-            case 3:
-                byte |= (ONE << 3);
-                return;
-            case 4:
-                byte |= (ONE << 4);
-                return;
-            case 5:
-                byte |= (ONE << 5);
-                return;
-            case 6:
-                byte |= (ONE << 6);
-                return;
-            case 7:
-                byte |= (ONE << 7);
-                return;
-            default:
-                throw invalid_argument("Fallen through switch in high()");
-        }
-    }
-
-    // functions to set val in bit^th position to 0
-    void low(const unsigned char bit) {
-        switch (bit) {
-            case 0:
-                byte &= (MAX ^ (ONE << 0));
-                return;
-            case 1:
-                byte &= (MAX ^ (ONE << 1));
-                return;
-            case 2:
-                byte &= (MAX ^ (ONE << 2));
-                return;
-            case 3:
-                byte &= (MAX ^ (ONE << 3));
-                return;
-            case 4:
-                byte &= (MAX ^ (ONE << 4));
-                return;
-            case 5:
-                byte &= (MAX ^ (ONE << 5));
-                return;
-            case 6:
-                byte &= (MAX ^ (ONE << 6));
-                return;
-            case 7:
-                byte &= (MAX ^ (ONE << 7));
-                return;
-            default:
-                throw invalid_argument("Fallen through switch in low()");
-        }
-    }
-
-    // functions to swap val in bit^th position
-    void flip(const unsigned char bit) {
-        switch (bit) {
-            case 0:
-                byte ^= (ONE << 0);
-                return;
-            case 1:
-                byte ^= (ONE << 1);
-                return;
-            case 2:
-                byte ^= (ONE << 2);
-                return;
-            case 3:
-                byte ^= (ONE << 3);
-                return;
-            case 4:
-                byte ^= (ONE << 4);
-                return;
-            case 5:
-                byte ^= (ONE << 5);
-                return;
-            case 6:
-                byte ^= (ONE << 6);
-                return;
-            case 7:
-                byte ^= (ONE << 7);
-                return;
-            default:
-                throw invalid_argument("Fallen through switch in flip()");
-        }
-    }
-
-    // function to lookup how many bits are set to one in byte in the lookup
-    // table
-    inline unsigned char count(void) { return cj::BitsSetTable256[byte]; }
-
-    // function to print the byte on one line one bit at a time
-    void print(bool endline) {
-        for (int i = 0; i < 8; ++i) {
-            cout << test(i) << ", ";
-        }
-        if (endline) cout << endl;
-        return;
-    }
-
-    inline unsigned char data(void) { return byte; }
-};
-
-/*----------------------------------------------------------------------------*/
-
 // Class to chain ByteOfBits together to achieve any length bit string, methods:
 // test(), flip(), high(), low(), print(), count(), print_all().
 // Actual size is always a multiple of 8 bits.
@@ -292,6 +148,445 @@ class DenseBitsH {
     }
 };
 
+/*----------------------------------------------------------------------------*/
+
+// Base class for the bit sets stored in 64 bit words using the curiously
+// recurring template pattern. E must provide words(), n_words(), n_bits() and
+// index(bit), which maps a bit argument into [0, n_bits()). Single bit
+// operations are branchless and bits past n_bits() are kept at 0. Methods:
+// test(), flip(), high(), low(), assign(), count(), clear(), print(),
+// print_all(), find_first(), find_next(), find_first_zero(),
+// find_next_zero(), ones(), whole set &=, |=, ^=, andnot(), invert(), ~ and
+// shl(), shr(), rotl(), rotr().
+template <class E>
+class WordBits {
+    inline E &self(void) { return static_cast<E &>(*this); }
+    inline E const &self(void) const { return static_cast<E const &>(*this); }
+
+    // helper for the find functions, clamps to n_bits()
+    inline uint64_t clamp(const uint64_t found) const {
+        return found < self().n_bits() ? found : self().n_bits();
+    }
+
+    // helper for whole set operations
+    template <class Op>
+    inline E &apply(const WordBits &other) {
+        if (self().n_bits() != other.self().n_bits()) {
+            throw invalid_argument("Bit sets must be the same size");
+        }
+        apply_words<Op>(self().words(), self().words(), other.self().words(),
+                        self().n_words());
+        return self();
+    }
+
+   public:
+    // functions to get val in bit^th position
+    inline bool test(uint64_t bit) const {
+        bit = self().index(bit);
+        return (self().words()[bit >> WORD_SHIFT] >> (bit & WORD_MASK)) &
+               WORD_ONE;
+    }
+
+    // functions to set val in bit^th position to 1
+    inline void high(uint64_t bit) {
+        bit = self().index(bit);
+        self().words()[bit >> WORD_SHIFT] |= WORD_ONE << (bit & WORD_MASK);
+    }
+
+    // functions to set val in bit^th position to 0
+    inline void low(uint64_t bit) {
+        bit = self().index(bit);
+        self().words()[bit >> WORD_SHIFT] &= ~(WORD_ONE << (bit & WORD_MASK));
+    }
+
+    // functions to swap val in bit^th position
+    inline void flip(uint64_t bit) {
+        bit = self().index(bit);
+        self().words()[bit >> WORD_SHIFT] ^= WORD_ONE << (bit & WORD_MASK);
+    }
+
+    // functions to set val in bit^th position to val without branching
+    inline void assign(uint64_t bit, const bool val) {
+        bit = self().index(bit);
+        uint64_t &word = self().words()[bit >> WORD_SHIFT];
+        const uint64_t mask = WORD_ONE << (bit & WORD_MASK);
+        word ^= (-static_cast<uint64_t>(val) ^ word) & mask;
+    }
+
+    // function to see how many bits are set to 1 in set
+    inline uint64_t count(void) const {
+        return popcount_words(self().words(), self().n_words());
+    }
+
+    // function to set every bit to 0
+    inline void clear(void) {
+        std::fill(self().words(), self().words() + self().n_words(), 0);
+    }
+
+    /*----------------------------Set bit searches----------------------------*/
+
+    // function to find the index of the first bit set to 1, n_bits() if none
+    inline uint64_t find_first(void) const {
+        return clamp(find_words(self().words(), self().n_words(), 0));
+    }
+
+    // function to find the index of the first bit set to 1 after bit,
+    // n_bits() if none
+    inline uint64_t find_next(const uint64_t bit) const {
+        return clamp(find_words(self().words(), self().n_words(), bit + 1));
+    }
+
+    // function to find the index of the first bit set to 0, n_bits() if none
+    inline uint64_t find_first_zero(void) const {
+        return clamp(find_zero_words(self().words(), self().n_words(), 0));
+    }
+
+    // function to find the index of the first bit set to 0 after bit,
+    // n_bits() if none
+    inline uint64_t find_next_zero(const uint64_t bit) const {
+        return clamp(
+            find_zero_words(self().words(), self().n_words(), bit + 1));
+    }
+
+    // range over the indices of the set bits, for (uint64_t i : bits.ones())
+    inline OnesRange ones(void) const {
+        return OnesRange(self().words(), self().n_words());
+    }
+
+    /*--------------------------Whole set operations--------------------------*/
+
+    // functions to combine with another set word by word
+    inline E &operator&=(const WordBits &other) { return apply<OpAnd>(other); }
+    inline E &operator|=(const WordBits &other) { return apply<OpOr>(other); }
+    inline E &operator^=(const WordBits &other) { return apply<OpXor>(other); }
+
+    // function to set to 0 every bit that is 1 in other
+    inline E &andnot(const WordBits &other) { return apply<OpAndNot>(other); }
+
+    // function to swap every bit in the set
+    inline E &invert(void) {
+        if (self().n_words() != 0) {
+            not_words(self().words(), self().words(), self().n_words());
+            self().words()[self().n_words() - 1] &= tail_mask(self().n_bits());
+        }
+        return self();
+    }
+
+    // returns a copy with every bit swapped
+    E operator~(void) const {
+        E out(self());
+        out.invert();
+        return out;
+    }
+
+    /*---------------------------Shifts and rotations-------------------------*/
+
+    // function to move every bit from i to i + k, bits past the end are lost
+    inline E &shl(const uint64_t k) {
+        shl_words(self().words(), self().words(), self().n_words(), k);
+        if (self().n_words() != 0) {
+            self().words()[self().n_words() - 1] &= tail_mask(self().n_bits());
+        }
+        return self();
+    }
+
+    // function to move every bit from i to i - k, bits past 0 are lost
+    inline E &shr(const uint64_t k) {
+        shr_words(self().words(), self().words(), self().n_words(), k);
+        return self();
+    }
+
+    // function to move every bit from i to (i + k) % n_bits(), periodic
+    inline E &rotl(const uint64_t k) {
+        E tmp(self());
+        rotl_words(self().words(), tmp.words(), self().n_bits(), k);
+        return self();
+    }
+
+    // function to move every bit from i to (i - k) % n_bits(), periodic
+    inline E &rotr(const uint64_t k) {
+        E tmp(self());
+        rotr_words(self().words(), tmp.words(), self().n_bits(), k);
+        return self();
+    }
+
+    /*------------------------------------------------------------------------*/
+
+    // function to print the set on one line one bit at a time
+    // Just print bits up to n_bits()
+    void print(void) const {
+        if (self().n_bits() != 0) cout << PRINTER[test(0)];
+        for (uint64_t i = 1; i < self().n_bits(); ++i) {
+            cout << PRINTER[2] << PRINTER[test(i)];
+        }
+        cout << "\n";
+    }
+
+    // function to print the set on one line one bit at a time
+    // prints all bits
+    void print_all(void) const {
+        for (uint64_t i = 0; i < self().n_words() * 64; ++i) {
+            cout << ((self().words()[i >> WORD_SHIFT] >> (i & WORD_MASK)) &
+                     WORD_ONE);
+        }
+        cout << " endl" << endl;
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Same interface as DenseBitsH but stores the bits in 64 bit words, see
+// WordBits for methods. Bit arguments wrap modulo size like DenseBitsH.
+// Actual size is always a multiple of 64 bits.
+// Allocated on heap
+template <uint32_t size>
+class DenseBitsW : public WordBits<DenseBitsW<size>> {
+   public:
+    static const uint32_t length = words_for(size);
+    uint64_t *set = nullptr;
+
+    inline uint64_t *words(void) { return set; }
+    inline const uint64_t *words(void) const { return set; }
+    static constexpr uint64_t n_words(void) { return length; }
+    static constexpr uint64_t n_bits(void) { return size; }
+    static inline uint64_t index(const uint64_t bit) { return bit % size; }
+
+    // constructor
+    DenseBitsW<size>(void) { set = new uint64_t[length](); }
+
+    // de-constructor
+    ~DenseBitsW<size>(void) {
+        delete[] set;
+        set = nullptr;
+    }
+
+    // copy constructor for functions
+    DenseBitsW<size>(DenseBitsW const &other) : WordBits<DenseBitsW>() {
+        set = new uint64_t[length];
+        std::copy(other.set, other.set + length, set);
+    }
+
+    // move constructor
+    DenseBitsW<size>(DenseBitsW &&other) noexcept {
+        set = other.set;
+        other.set = nullptr;
+    }
+
+    // assignment operator
+    DenseBitsW<size> &operator=(const DenseBitsW &other) {
+        if (this != &other) {
+            std::copy(other.set, other.set + length, set);
+        }
+        return *this;
+    }
+
+    // move operator
+    DenseBitsW<size> &operator=(DenseBitsW &&other) noexcept {
+        if (this != &other) {
+            delete[] set;
+            set = other.set;
+            other.set = nullptr;
+        }
+        return *this;
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// As DenseBitsW but the words are stored inline so the set lives wherever the
+// object does, e.g. on the stack. An array of DenseBitsS is one contiguous
+// block of words. See WordBits for methods.
+template <uint32_t size>
+class DenseBitsS : public WordBits<DenseBitsS<size>> {
+   public:
+    static const uint32_t length = words_for(size);
+    uint64_t set[length] = {};
+
+    inline uint64_t *words(void) { return set; }
+    inline const uint64_t *words(void) const { return set; }
+    static constexpr uint64_t n_words(void) { return length; }
+    static constexpr uint64_t n_bits(void) { return size; }
+    static inline uint64_t index(const uint64_t bit) { return bit % size; }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Bit set sized at run time that can grow, see WordBits for methods. Bit
+// arguments are not wrapped and must be less than size().
+// Allocated on heap
+class DynamicBits : public WordBits<DynamicBits> {
+    uint64_t *m_set = nullptr;
+    uint64_t m_bits = 0;
+    uint64_t m_capacity = 0;  // in words
+
+    // reallocate to hold at least words words, keeping the contents
+    void regrow(const uint64_t words) {
+        uint64_t *tmp = new uint64_t[words]();
+        std::copy(m_set, m_set + n_words(), tmp);
+        delete[] m_set;
+        m_set = tmp;
+        m_capacity = words;
+    }
+
+   public:
+    inline uint64_t *words(void) { return m_set; }
+    inline const uint64_t *words(void) const { return m_set; }
+    inline uint64_t n_words(void) const { return words_for(m_bits); }
+    inline uint64_t n_bits(void) const { return m_bits; }
+    static inline uint64_t index(const uint64_t bit) { return bit; }
+
+    // return number of bits in the set
+    inline uint64_t size(void) const { return m_bits; }
+
+    // return number of bits the set can hold without reallocating
+    inline uint64_t capacity(void) const { return m_capacity * 64; }
+
+    // function to make space for at least bits bits
+    void reserve(const uint64_t bits) {
+        if (words_for(bits) > m_capacity) regrow(words_for(bits));
+    }
+
+    // function to change the number of bits, new bits are 0
+    void resize(const uint64_t bits) {
+        if (words_for(bits) > m_capacity) {
+            regrow(std::max(words_for(bits), 2 * m_capacity));
+        }
+        if (bits < m_bits) {
+            // zero everything past the new end so growing again reads 0
+            std::fill(m_set + words_for(bits), m_set + n_words(), 0);
+            if (words_for(bits) != 0) {
+                m_set[words_for(bits) - 1] &= tail_mask(bits);
+            }
+        }
+        m_bits = bits;
+    }
+
+    // function to add a bit to the end of the set
+    inline void push_back(const bool val) {
+        if (m_bits == capacity()) regrow(m_capacity == 0 ? 1 : 2 * m_capacity);
+        ++m_bits;
+        assign(m_bits - 1, val);
+    }
+
+    // constructor
+    explicit DynamicBits(const uint64_t bits = 0) { resize(bits); }
+
+    // de-constructor
+    ~DynamicBits(void) {
+        delete[] m_set;
+        m_set = nullptr;
+    }
+
+    // copy constructor for functions
+    DynamicBits(DynamicBits const &other)
+        : WordBits<DynamicBits>(), m_bits{other.m_bits} {
+        m_capacity = other.n_words();
+        m_set = new uint64_t[m_capacity];
+        std::copy(other.m_set, other.m_set + m_capacity, m_set);
+    }
+
+    // move constructor
+    DynamicBits(DynamicBits &&other) noexcept
+        : m_set{other.m_set},
+          m_bits{other.m_bits},
+          m_capacity{other.m_capacity} {
+        other.m_set = nullptr;
+        other.m_bits = 0;
+        other.m_capacity = 0;
+    }
+
+    // assignment operator, zeroes the words past the new end so growing
+    // again with resize() reads 0
+    DynamicBits &operator=(const DynamicBits &other) {
+        if (this != &other) {
+            const uint64_t old = n_words();
+            m_bits = 0;
+            reserve(other.m_bits);
+            m_bits = other.m_bits;
+            std::copy(other.m_set, other.m_set + n_words(), m_set);
+            if (old > n_words()) std::fill(m_set + n_words(), m_set + old, 0);
+        }
+        return *this;
+    }
+
+    // move operator
+    DynamicBits &operator=(DynamicBits &&other) noexcept {
+        if (this != &other) {
+            delete[] m_set;
+            m_set = other.m_set;
+            m_bits = other.m_bits;
+            m_capacity = other.m_capacity;
+            other.m_set = nullptr;
+            other.m_bits = 0;
+            other.m_capacity = 0;
+        }
+        return *this;
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// functions to combine two sets into a new set
+template <class E>
+E operator&(const WordBits<E> &a, const WordBits<E> &b) {
+    E out(static_cast<E const &>(a));
+    out &= b;
+    return out;
+}
+
+template <class E>
+E operator|(const WordBits<E> &a, const WordBits<E> &b) {
+    E out(static_cast<E const &>(a));
+    out |= b;
+    return out;
+}
+
+template <class E>
+E operator^(const WordBits<E> &a, const WordBits<E> &b) {
+    E out(static_cast<E const &>(a));
+    out ^= b;
+    return out;
+}
+
+template <class E>
+E andnot(const WordBits<E> &a, const WordBits<E> &b) {
+    E out(static_cast<E const &>(a));
+    out.andnot(b);
+    return out;
+}
+
+// functions to count the bits set in a combination of two sets without
+// building it, e.g. count_and(a, b) == (a & b).count()
+template <class Op, class E>
+inline uint64_t count_op(const WordBits<E> &a, const WordBits<E> &b) {
+    E const &x = static_cast<E const &>(a);
+    E const &y = static_cast<E const &>(b);
+    if (x.n_bits() != y.n_bits()) {
+        throw invalid_argument("Bit sets must be the same size");
+    }
+    return count_words<Op>(x.words(), y.words(), x.n_words());
+}
+
+template <class E>
+inline uint64_t count_and(const WordBits<E> &a, const WordBits<E> &b) {
+    return count_op<OpAnd>(a, b);
+}
+
+template <class E>
+inline uint64_t count_or(const WordBits<E> &a, const WordBits<E> &b) {
+    return count_op<OpOr>(a, b);
+}
+
+template <class E>
+inline uint64_t count_xor(const WordBits<E> &a, const WordBits<E> &b) {
+    return count_op<OpXor>(a, b);
+}
+
+template <class E>
+inline uint64_t count_andnot(const WordBits<E> &a, const WordBits<E> &b) {
+    return count_op<OpAndNot>(a, b);
+}
+
 }  // namespace cj
 
 #endif  // BITSETS_HPP//
\ No newline at end of file
@@ -13,8 +13,10 @@
 
 #include <algorithm>
 #include <iostream>
+#include <utility>
 #include <vector>
 
+#include "BitMatrix.hpp"
 #include "DenseBits.hpp"
 #include "comforts.hpp"
 
@@ -25,10 +27,90 @@ using std::cout;
 using std::endl;
 using std::invalid_argument;
 
-template <uint32_t N>
+/*----------------------------------------------------------------------------*/
+
+// Class for the union-find of domain labels used by IsingArray::domain(),
+// methods: make(), find(), unite(), add(), compact(). Each root holds the
+// number of sites in its domain.
+class LabelForest {
+    std::vector<uint32_t> m_parent;
+    std::vector<uint32_t> m_size;
+    std::vector<uint32_t> m_remap;  // scratch space for compact()
+    std::vector<uint32_t> m_fresh;
+
+   public:
+    // function to make a new label with no sites
+    inline uint32_t make(void) {
+        m_parent.push_back(m_parent.size());
+        m_size.push_back(0);
+        return m_parent.size() - 1;
+    }
+
+    // function to find the root of x, halving the path as it goes
+    inline uint32_t find(uint32_t x) {
+        while (m_parent[x] != x) {
+            m_parent[x] = m_parent[m_parent[x]];
+            x = m_parent[x];
+        }
+        return x;
+    }
+
+    // function to join the labels of a and b, returns the new root
+    inline uint32_t unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return a;
+        if (m_size[a] < m_size[b]) std::swap(a, b);
+        m_parent[b] = a;
+        m_size[a] += m_size[b];
+        return a;
+    }
+
+    // function to add one site to the domain of x
+    inline void add(const uint32_t x) { ++m_size[find(x)]; }
+
+    // function to push the size of every domain with no label in keep or
+    // also onto done, then renumber the rest 0, 1, ... updating keep and also
+    void compact(std::vector<uint32_t> &keep, std::vector<uint32_t> &also,
+                 std::vector<uint32_t> &done) {
+        const uint32_t none = m_parent.size();
+        uint32_t next = 0;
+        m_remap.assign(m_parent.size(), none);
+        for (std::vector<uint32_t> *labels : {&keep, &also}) {
+            for (uint32_t &x : *labels) {
+                x = find(x);
+                if (m_remap[x] == none) m_remap[x] = next++;
+            }
+        }
+
+        m_fresh.assign(next, 0);
+        for (uint32_t x = 0; x < m_parent.size(); ++x) {
+            if (m_parent[x] != x) continue;
+            if (m_remap[x] == none) {
+                done.push_back(m_size[x]);
+            } else {
+                m_fresh[m_remap[x]] = m_size[x];
+            }
+        }
+        for (std::vector<uint32_t> *labels : {&keep, &also}) {
+            for (uint32_t &x : *labels) x = m_remap[x];
+        }
+
+        m_size.swap(m_fresh);
+        m_parent.resize(next);
+        for (uint32_t x = 0; x < next; ++x) m_parent[x] = x;
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for an N*N periodic lattice of spins, one Row of N bits per row.
+// Row defaults to the byte backed DenseBitsH, IsingWords below stores rows in
+// 64 bit words for the multi spin coded engines in IsingSweep.hpp.
+template <uint32_t N, class Row = DenseBitsH<N>>
 class IsingArray {
    public:
-    cj::DenseBitsH<N> *array = nullptr;
+    Row *array = nullptr;
 
     // functions to get val in i,j position
     inline bool test(const uint32_t i, const uint32_t j) const {
@@ -57,6 +139,35 @@ class IsingArray {
         return count;
     }
 
+    /*------------------------------Site index--------------------------------*/
+
+    // Sites numbered s = i * N + j for engines that work on any lattice. Row
+    // i holds sites [i * N, (i + 1) * N), so threads flipping sites in
+    // different rows never write the same word
+
+    static const uint32_t DEGREE = 4;  // neighbours per site
+
+    static constexpr uint64_t sites(void) { return uint64_t(N) * N; }
+
+    static constexpr uint64_t rows(void) { return N; }
+
+    inline bool test_site(const uint64_t s) const {
+        return array[s / N].test(s % N);
+    }
+
+    inline void flip_site(const uint64_t s) { array[s / N].flip(s % N); }
+
+    // function to write the sites next to s into out, the forward neighbour
+    // of each direction is at an even index and the backward one follows it
+    inline void neighbours(const uint64_t s, uint64_t (&out)[DEGREE]) const {
+        const uint64_t i = s / N;
+        const uint64_t j = s % N;
+        out[0] = (i + 1) % N * N + j;
+        out[1] = (i + N - 1) % N * N + j;
+        out[2] = i * N + (j + 1) % N;
+        out[3] = i * N + (j + N - 1) % N;
+    }
+
     /*-------------------------------Overloads--------------------------------*/
 
     template <typename T>
@@ -110,106 +221,67 @@ class IsingArray {
         return tmp;
     }
 
-    // functions to count the domain sizes, returns a vector of domain sizes
-    std::vector<uint32_t> domain(
-        const cj::Pair<uint32_t> (&order)[N * N]) const {
+    // function to find the size of every domain (connected set of equal
+    // spins, periodic in both directions) by Hoshen-Kopelman labelling one
+    // row at a time. Only the labels of row 0 and the current row are kept,
+    // so the extra memory is O(N) and the time O(N*N)
+    std::vector<uint32_t> domain(void) const {
         std::vector<uint32_t> domains;
-        IsingArray<N> used;
-
-        uint32_t count = 0;
-        uint32_t position = 0;
-        uint32_t i;
-        uint32_t j;
-        bool type;
-
-        while (count < N * N) {
-            if (used.test(order[position]) == 0) {
-                uint32_t size = 1;
-                i = order[position].i;
-                j = order[position].j;
-
-                type = test(i, j);
-                used.high(i, j);
-
-                size = _left(i, j - 1 + N, size, type, used);
-                size = _up(i + 1, j, size, type, used);
-                size = _right(i, j + 1, size, type, used);
-                size = _down(i - 1 + N, j, size, type, used);
-
-                domains.push_back(size);
-                count += size;
+        LabelForest forest;
+        std::vector<uint32_t> first(N);  // labels of row 0
+        std::vector<uint32_t> above(N);  // labels of row i - 1
+        std::vector<uint32_t> row(N);    // labels of row i
+
+        for (uint32_t i = 0; i < N; ++i) {
+            for (uint32_t j = 0; j < N; ++j) {
+                const bool spin = test(i, j);
+                const bool left = j > 0 && test(i, j - 1) == spin;
+                const bool up = i > 0 && test(i - 1, j) == spin;
+                if (left && up) {
+                    row[j] = forest.unite(row[j - 1], above[j]);
+                } else if (left) {
+                    row[j] = row[j - 1];
+                } else if (up) {
+                    row[j] = above[j];
+                } else {
+                    row[j] = forest.make();
+                }
+                forest.add(row[j]);
+            }
+            if (test(i, N - 1) == test(i, 0)) forest.unite(row[N - 1], row[0]);
+            if (i == 0) first = row;
+            if (i == N - 1) {
+                for (uint32_t j = 0; j < N; ++j) {
+                    if (test(i, j) == test(0, j)) {
+                        forest.unite(row[j], first[j]);
+                    }
+                }
+                first.clear();
+                row.clear();
             }
-            ++position;
+            forest.compact(first, row, domains);
+            above.swap(row);
+            row.resize(N);
         }
-
         return domains;
     }
 
-    // domain helper function
-    uint32_t _left(const uint32_t i, const uint32_t j, uint32_t size,
-                   const bool type, IsingArray<N> &ising) {
-        // dcout("left at " << i << " " << j);
-        if (test(i, j) == type && ising.test(i, j) == 0) {
-            ising.high(i, j);
-            size += 1;
-
-            size = _left(i, j - 1 + N, size, type, ising);
-            size = _up(i + 1, j, size, type, ising);
-            size = _down(i - 1 + N, j, size, type, ising);
-        }
-
-        return size;
-    }
-
-    // domain helper function
-    uint32_t _up(const uint32_t i, const uint32_t j, uint32_t size,
-                 const bool type, IsingArray<N> &ising) {
-        // dcout("up at " << i << " " << j);
-        if (test(i, j) == type && ising.test(i, j) == 0) {
-            ising.high(i, j);
-            size += 1;
-
-            size = _left(i, j - 1 + N, size, type, ising);
-            size = _up(i + 1, j, size, type, ising);
-            size = _right(i, j + 1, size, type, ising);
-        }
-
-        return size;
-    }
-
-    // domain helper function
-    uint32_t _right(const uint32_t i, const uint32_t j, uint32_t size,
-                    const bool type, IsingArray<N> &ising) {
-        // dcout("right at " << i << " " << j);
-        if (test(i, j) == type && ising.test(i, j) == 0) {
-            ising.high(i, j);
-            size += 1;
-
-            size = _up(i + 1, j, size, type, ising);
-            size = _right(i, j + 1, size, type, ising);
-            size = _down(i - 1 + N, j, size, type, ising);
+    // function to count the domains of each size, returns (size, count)
+    // pairs in increasing size
+    std::vector<std::pair<uint32_t, uint32_t>> domain_histogram(void) const {
+        std::vector<uint32_t> sizes = domain();
+        std::sort(sizes.begin(), sizes.end());
+        std::vector<std::pair<uint32_t, uint32_t>> histogram;
+        for (uint32_t size : sizes) {
+            if (histogram.empty() || histogram.back().first != size) {
+                histogram.emplace_back(size, 0);
+            }
+            ++histogram.back().second;
         }
-
-        return size;
+        return histogram;
     }
 
-    // domain helper function
-    uint32_t _down(const uint32_t i, const uint32_t j, uint32_t size,
-                   const bool type, IsingArray<N> &ising) {
-        // dcout("down at " << i << " " << j);
-        if (test(i, j) == type && ising.test(i, j) == 0) {
-            ising.high(i, j);
-            size += 1;
-
-            size = _left(i, j - 1 + N, size, type, ising);
-            size = _right(i, j + 1, size, type, ising);
-            size = _down(i - 1 + N, j, size, type, ising);
-        }
-
-        return size;
-    }
-
-    // function to print the ith DenseBitsH on one line
+    // function to print the ith row on one line
     void print(const uint32_t i) const { array[i % N].print(); }
 
     // function to print all the Ising array
@@ -221,7 +293,7 @@ class IsingArray {
     }
 
     // constructor
-    IsingArray() { array = new cj::DenseBitsH<N>[N]; }
+    IsingArray() { array = new Row[N]; }
 
     // de-constructor
     ~IsingArray() {
@@ -234,7 +306,7 @@ class IsingArray {
         if (this != &other) {
             delete[] array;
             array = nullptr;
-            array = new DenseBitsH<N>[N];
+            array = new Row[N];
             std::copy(other.array, other.array + N, array);
         }
         dcout("copy");
@@ -262,6 +334,352 @@ class IsingArray {
     }
 };  // namespace cj
 
+// N*N lattice with rows of 64 bit words stored inline, so the whole lattice
+// is one allocation
+template <uint32_t N>
+using IsingWords = IsingArray<N, DenseBitsS<N>>;
+
+/*----------------------------------------------------------------------------*/
+
+// Class for an N*N periodic lattice in one 64 byte aligned buffer of N + 2
+// rows, with the methods of IsingArray plus refresh(), row() and interior().
+// Each row is padded to STRIDE words with site j at bit j + 1, ghost columns
+// at bits 0 and N + 1 copy sites N - 1 and 0, and ghost rows -1 and N copy
+// rows N - 1 and 0. Every neighbour of a site is then a plain bit offset away,
+// with one pointer and no % N. Writes through high(), low(), flip() and
+// flip_site() keep the ghosts in step, code writing whole words through row()
+// must call refresh() afterwards.
+template <uint32_t N>
+class IsingHalo {
+   public:
+    static const uint32_t STRIDE = words_for(N + 2);             // words
+    static const uint64_t ROW = uint64_t(STRIDE) << WORD_SHIFT;  // bits
+
+   private:
+    uint64_t *m_raw = nullptr;
+    uint64_t *m_data = nullptr;  // 64 byte aligned into m_raw
+
+    // bit of site i, j in the buffer, -1 and N reach the ghosts
+    static inline uint64_t at(const uint32_t i, const uint32_t j) {
+        return (i + 1u) * ROW + (j + 1u);
+    }
+
+    inline bool get(const uint64_t b) const {
+        return (m_data[b >> WORD_SHIFT] >> (b & WORD_MASK)) & WORD_ONE;
+    }
+
+    inline void toggle(const uint64_t b) {
+        m_data[b >> WORD_SHIFT] ^= WORD_ONE << (b & WORD_MASK);
+    }
+
+    // allocate zeroed storage for N + 2 rows aligned to 64 bytes
+    inline void alloc(void) {
+        m_raw = new uint64_t[(N + 2) * STRIDE + 8]();
+        uintptr_t addr = reinterpret_cast<uintptr_t>(m_raw);
+        m_data = reinterpret_cast<uint64_t *>((addr + 63) & ~uintptr_t(63));
+    }
+
+   public:
+    // mask of the bits of word w of a row holding sites, not ghosts
+    static inline uint64_t interior(const uint32_t w) {
+        const uint32_t last = words_for(N + 1) - 1;  // word holding site N - 1
+        uint64_t mask = w > last ? 0 : ~0ULL;
+        if (w == 0) mask &= ~WORD_ONE;
+        if (w == last) mask &= tail_mask(N + 1);
+        return mask;
+    }
+
+    // function to get the words of row i, -1 and N are the ghost rows
+    inline uint64_t *row(const uint32_t i) {
+        return m_data + (i + 1u) * STRIDE;
+    }
+    inline const uint64_t *row(const uint32_t i) const {
+        return m_data + (i + 1u) * STRIDE;
+    }
+
+    // functions to get val in i,j position, one step outside reads a ghost
+    inline bool test(const uint32_t i, const uint32_t j) const {
+        return get(at(i, j));
+    }
+
+    // functions to swap val in i,j position and its ghost copies
+    inline void flip(const uint32_t i, const uint32_t j) {
+        toggle(at(i, j));
+        if (i == 0) toggle(at(N, j));
+        if (i == N - 1) toggle(at(-1, j));
+        if (j == 0) toggle(at(i, N));
+        if (j == N - 1) toggle(at(i, -1));
+    }
+
+    // functions to set val in i,j position to 1
+    inline void high(const uint32_t i, const uint32_t j) {
+        if (!test(i, j)) flip(i, j);
+    }
+
+    // functions to set val in i,j position to 0
+    inline void low(const uint32_t i, const uint32_t j) {
+        if (test(i, j)) flip(i, j);
+    }
+
+    // function to see how many bits are set to 1 in next to i,j
+    inline int adjacent(const uint32_t i, const uint32_t j) const {
+        const uint64_t b = at(i, j);
+        return get(b + ROW) + get(b - ROW) + get(b + 1) + get(b - 1);
+    }
+
+    // function to copy the edges of the lattice into the ghosts
+    void refresh(void) {
+        for (uint32_t i = 0; i < N; ++i) {
+            if (test(i, -1) != test(i, N - 1)) toggle(at(i, -1));
+            if (test(i, N) != test(i, 0)) toggle(at(i, N));
+        }
+        copy(row(N - 1), row(N - 1) + STRIDE, row(-1));
+        copy(row(0), row(0) + STRIDE, row(N));
+    }
+
+    /*------------------------------Site index--------------------------------*/
+
+    static const uint32_t DEGREE = 4;  // neighbours per site
+
+    static constexpr uint64_t sites(void) { return uint64_t(N) * N; }
+
+    static constexpr uint64_t rows(void) { return N; }
+
+    inline bool test_site(const uint64_t s) const { return test(s / N, s % N); }
+
+    inline void flip_site(const uint64_t s) { flip(s / N, s % N); }
+
+    // function to write the sites next to s into out, in the order of
+    // IsingArray::neighbours()
+    inline void neighbours(const uint64_t s, uint64_t (&out)[DEGREE]) const {
+        const uint64_t i = s / N;
+        const uint64_t j = s % N;
+        out[0] = i + 1 == N ? j : s + N;
+        out[1] = i == 0 ? s + sites() - N : s - N;
+        out[2] = j + 1 == N ? s - j : s + 1;
+        out[3] = j == 0 ? s + N - 1 : s - 1;
+    }
+
+    /*------------------------------------------------------------------------*/
+
+    // function to see how many bits are set to 1 in array
+    inline uint64_t count(void) const {
+        uint64_t count = 0;
+        for (uint32_t i = 0; i < N; ++i) {
+            for (uint32_t w = 0; w < STRIDE; ++w) {
+                count += popcount(row(i)[w] & interior(w));
+            }
+        }
+        return count;
+    }
+
+    // function to find total intrinsic energy
+    inline double intrinisic(const double (&lookup)[5][2]) const {
+        double tmp = 0;
+        for (unsigned i = 0; i < N; ++i) {
+            for (unsigned j = 0; j < N; ++j) {
+                tmp += lookup[adjacent(i, j)][test(i, j)];
+            }
+        }
+        return tmp;
+    }
+
+    // function to print the ith row on one line
+    void print(const uint32_t i) const {
+        cout << PRINTER[test(i, 0)];
+        for (uint32_t j = 1; j < N; ++j) {
+            cout << PRINTER[2] << PRINTER[test(i, j)];
+        }
+        cout << "\n";
+    }
+
+    // function to print all the Ising array
+    void print_all(void) const {
+        for (unsigned i = 0; i < N; ++i) {
+            print(i);
+        }
+        cout << endl;
+    }
+
+    // constructor
+    IsingHalo() { alloc(); }
+
+    // de-constructor
+    ~IsingHalo() {
+        delete[] m_raw;
+        m_raw = nullptr;
+        m_data = nullptr;
+    }
+
+    // copy constructor
+    IsingHalo(IsingHalo const &other) {
+        alloc();
+        copy(other.m_data, other.m_data + (N + 2) * STRIDE, m_data);
+    }
+
+    // assignment operator
+    IsingHalo &operator=(const IsingHalo &other) {
+        if (this != &other) {
+            copy(other.m_data, other.m_data + (N + 2) * STRIDE, m_data);
+        }
+        return *this;
+    }
+
+    // move constructor
+    IsingHalo(IsingHalo &&other) noexcept
+        : m_raw{other.m_raw}, m_data{other.m_data} {
+        other.m_raw = nullptr;
+        other.m_data = nullptr;
+    }
+
+    // move operator
+    IsingHalo &operator=(IsingHalo &&other) noexcept {
+        if (this != &other) {
+            delete[] m_raw;
+            m_raw = other.m_raw;
+            m_data = other.m_data;
+            other.m_raw = nullptr;
+            other.m_data = nullptr;
+        }
+        return *this;
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for 64 independent N*N periodic lattices spin coded across words,
+// methods: word(), test(), high(), low(), flip(), adjacent(), count(),
+// energy(), energies(), copy_to(), copy_from(). Bit b of the word at i,j is
+// spin i,j of replica b, so one word operation acts on all 64 replicas, e.g.
+// in ReplicaMetropolis from IsingSweep.hpp. The N*N words are one allocation.
+template <uint32_t N>
+class IsingReplicas {
+    std::vector<uint64_t> m_data;
+
+   public:
+    static const uint32_t REPLICAS = 64;
+
+    // function to get the word of the i,j spins of every replica
+    inline uint64_t &word(const uint32_t i, const uint32_t j) {
+        return m_data[i % N * N + j % N];
+    }
+    inline uint64_t word(const uint32_t i, const uint32_t j) const {
+        return m_data[i % N * N + j % N];
+    }
+
+    // function to get the words of row i
+    inline uint64_t *row(const uint32_t i) { return m_data.data() + i * N; }
+    inline const uint64_t *row(const uint32_t i) const {
+        return m_data.data() + i * N;
+    }
+
+    // functions to get val of replica b in i,j position
+    inline bool test(const uint32_t b, const uint32_t i,
+                     const uint32_t j) const {
+        return (word(i, j) >> b) & WORD_ONE;
+    }
+
+    // functions to set val of replica b in i,j position to 1
+    inline void high(const uint32_t b, const uint32_t i, const uint32_t j) {
+        word(i, j) |= WORD_ONE << b;
+    }
+
+    // functions to set val of replica b in i,j position to 0
+    inline void low(const uint32_t b, const uint32_t i, const uint32_t j) {
+        word(i, j) &= ~(WORD_ONE << b);
+    }
+
+    // functions to swap val of replica b in i,j position
+    inline void flip(const uint32_t b, const uint32_t i, const uint32_t j) {
+        word(i, j) ^= WORD_ONE << b;
+    }
+
+    // function to see how many bits of replica b are set to 1 in next to i,j
+    inline int adjacent(const uint32_t b, const uint32_t i,
+                        const uint32_t j) const {
+        int count = test(b, i + 1, j);
+        count += test(b, i - 1 + N, j);  //+N to stop % neg in test
+        count += test(b, i, j + 1);
+        count += test(b, i, j - 1 + N);
+        return count;
+    }
+
+    // function to see how many bits of replica b are set to 1
+    inline uint64_t count(const uint32_t b) const {
+        uint64_t count = 0;
+        for (const uint64_t w : m_data) count += (w >> b) & WORD_ONE;
+        return count;
+    }
+
+    // function to find the energy with J = 1 and no field of replica b
+    inline int64_t energy(const uint32_t b) const {
+        int64_t aligned = 0;
+        for (uint32_t i = 0; i < N; ++i) {
+            for (uint32_t j = 0; j < N; ++j) {
+                aligned += test(b, i, j) == test(b, i + 1, j);
+                aligned += test(b, i, j) == test(b, i, j + 1);
+            }
+        }
+        return 2 * int64_t(N) * N - 2 * aligned;
+    }
+
+    // function to find the energy of every replica at once. The aligned
+    // bonds of all replicas are summed in bit sliced counters, bit k of
+    // plane[k] being digit k of the count of replica b, and one transpose
+    // turns the planes into the 64 counts
+    void energies(int64_t (&out)[REPLICAS]) const {
+        uint64_t plane[64] = {};
+        for (uint32_t i = 0; i < N; ++i) {
+            for (uint32_t j = 0; j < N; ++j) {
+                const uint64_t s = word(i, j);
+                for (uint64_t carry : {~(s ^ word(i + 1, j)),
+                                       ~(s ^ word(i, j + 1))}) {
+                    for (uint32_t k = 0; carry != 0; ++k) {
+                        const uint64_t next = plane[k] & carry;
+                        plane[k] ^= carry;
+                        carry = next;
+                    }
+                }
+            }
+        }
+        transpose64(plane);
+        for (uint32_t b = 0; b < REPLICAS; ++b) {
+            out[b] = 2 * int64_t(N) * N - 2 * int64_t(plane[b]);
+        }
+    }
+
+    // function to copy replica b into an N*N lattice with test(), high() and
+    // low(), e.g. IsingArray, and back
+    template <class L>
+    void copy_to(const uint32_t b, L &lattice) const {
+        for (uint32_t i = 0; i < N; ++i) {
+            for (uint32_t j = 0; j < N; ++j) {
+                if (test(b, i, j)) {
+                    lattice.high(i, j);
+                } else {
+                    lattice.low(i, j);
+                }
+            }
+        }
+    }
+
+    template <class L>
+    void copy_from(const uint32_t b, const L &lattice) {
+        for (uint32_t i = 0; i < N; ++i) {
+            for (uint32_t j = 0; j < N; ++j) {
+                if (lattice.test(i, j)) {
+                    high(b, i, j);
+                } else {
+                    low(b, i, j);
+                }
+            }
+        }
+    }
+
+    // constructor with every spin of every replica 0
+    IsingReplicas() : m_data(uint64_t(N) * N) {}
+};
+
 }  // namespace cj
 
 #endif
\ No newline at end of file
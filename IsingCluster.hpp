@@ -0,0 +1,240 @@
+/**
+ * IsingCluster.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Cluster updates for Ising lattices, which decorrelate near the critical
+ * temperature in far fewer steps than local updates. The engines work on any
+ * lattice L with the site index interface of IsingArray: L::DEGREE,
+ * sites(), rows(), test_site(), flip_site() and neighbours().
+ */
+
+#ifndef ISINGCLUSTER_HPP
+#define ISINGCLUSTER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Barrier.hpp"
+#include "Xoshiro.hpp"
+
+namespace cj {
+
+// Class for the Wolff single cluster update with J = 1 and no field, methods:
+// step(), sweep(), beta(), set_beta(), rng(). A cluster grows from a random
+// seed adding aligned neighbours with probability 1 - exp(-2 beta). Sites are
+// flipped as they are added, so an added site no longer matches the cluster
+// spin and can never be added twice: no visited set is needed. The stack is
+// sized to sites() on first use, after that a step never allocates.
+template <class L>
+class Wolff {
+    Xoshiro256 m_rng;
+    double m_beta;
+    uint64_t m_add;  // threshold for adding a bond
+    std::vector<uint64_t> m_stack;
+
+   public:
+    // function to grow and flip one cluster, returns its size
+    uint64_t step(L &lattice) {
+        m_stack.reserve(lattice.sites());
+
+        const uint64_t seed = m_rng.below(lattice.sites());
+        const bool spin = lattice.test_site(seed);
+        lattice.flip_site(seed);
+        m_stack.push_back(seed);
+
+        uint64_t size = 1;
+        uint64_t next[L::DEGREE];
+        while (!m_stack.empty()) {
+            const uint64_t s = m_stack.back();
+            m_stack.pop_back();
+            lattice.neighbours(s, next);
+            for (uint32_t k = 0; k < L::DEGREE; ++k) {
+                if (lattice.test_site(next[k]) == spin && m_rng() < m_add) {
+                    lattice.flip_site(next[k]);
+                    m_stack.push_back(next[k]);
+                    ++size;
+                }
+            }
+        }
+        return size;
+    }
+
+    // function to flip a fixed number of clusters, returns the spins flipped.
+    // Stopping once sites() spins have flipped instead would make the stop
+    // depend on the state and bias measurements taken between sweeps
+    uint64_t sweep(L &lattice, const uint64_t clusters = 1) {
+        uint64_t flipped = 0;
+        for (uint64_t k = 0; k < clusters; ++k) flipped += step(lattice);
+        return flipped;
+    }
+
+    // function to change the inverse temperature
+    inline void set_beta(const double beta) {
+        if (beta < 0) throw std::invalid_argument("beta must be >= 0");
+        m_beta = beta;
+        m_add = threshold(1 - std::exp(-2 * beta));
+    }
+
+    inline double beta(void) const { return m_beta; }
+
+    inline Xoshiro256 &rng(void) { return m_rng; }
+
+    // constructor taking a generator
+    Wolff(const double beta, const Xoshiro256 &rng) : m_rng{rng} {
+        set_beta(beta);
+    }
+
+    // constructor
+    explicit Wolff(const double beta, const uint64_t seed = 1)
+        : Wolff(beta, Xoshiro256(seed)) {}
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for the Swendsen-Wang multi cluster update with J = 1 and no field,
+// methods: sweep(), beta(), set_beta(), threads(). Each step every thread
+// takes a block of rows and places bonds from its sites to their forward
+// neighbours, joining the ends in a shared lock free union-find: roots are
+// linked larger index under smaller with one compare and swap, and finds
+// halve paths as they go. Then every thread flips the sites of its rows whose
+// root hashes to 1 with that step's seed, so each cluster flips with
+// probability 1/2 with no communication. Threads only meet at barriers.
+template <class L>
+class SwendsenWang {
+    std::vector<std::atomic<uint32_t>> m_parent;
+    std::vector<Xoshiro256> m_rng;  // one stream per thread
+    double m_beta;
+    uint64_t m_add;  // threshold for placing a bond
+
+    // function to find the root of x, pointing x at its grandparent
+    inline uint32_t find(uint32_t x) {
+        while (true) {
+            uint32_t p = m_parent[x].load(std::memory_order_relaxed);
+            if (p == x) return x;
+            const uint32_t gp = m_parent[p].load(std::memory_order_relaxed);
+            if (p != gp) {
+                m_parent[x].compare_exchange_weak(p, gp,
+                                                  std::memory_order_relaxed);
+            }
+            x = gp;
+        }
+    }
+
+    // function to join the clusters of a and b
+    inline void unite(uint32_t a, uint32_t b) {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return;
+            if (a < b) std::swap(a, b);
+            uint32_t root = a;
+            if (m_parent[a].compare_exchange_weak(root, b,
+                                                  std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    void run(const uint32_t t, const uint32_t workers, L &lattice,
+             Barrier &barrier, const uint64_t steps, const uint64_t seed,
+             std::atomic<uint64_t> &clusters) {
+        const uint64_t row = lattice.sites() / lattice.rows();
+        const uint64_t begin = t * lattice.rows() / workers * row;
+        const uint64_t end = (t + 1) * lattice.rows() / workers * row;
+        Xoshiro256 &rng = m_rng[t];
+        uint64_t next[L::DEGREE];
+
+        for (uint64_t k = 0; k < steps; ++k) {
+            for (uint64_t s = begin; s < end; ++s) {
+                m_parent[s].store(s, std::memory_order_relaxed);
+            }
+            barrier.wait();
+
+            for (uint64_t s = begin; s < end; ++s) {
+                const bool spin = lattice.test_site(s);
+                lattice.neighbours(s, next);
+                for (uint32_t d = 0; d < L::DEGREE; d += 2) {
+                    if (lattice.test_site(next[d]) == spin && rng() < m_add) {
+                        unite(s, next[d]);
+                    }
+                }
+            }
+            barrier.wait();
+
+            const uint64_t salt = mix64(seed + k);
+            uint64_t roots = 0;
+            for (uint64_t s = begin; s < end; ++s) {
+                const uint32_t root = find(s);
+                roots += root == s;
+                if (mix64(root ^ salt) & 1) lattice.flip_site(s);
+            }
+            if (k + 1 == steps) clusters += roots;
+            barrier.wait();  // roots must not move until every flip is done
+        }
+    }
+
+   public:
+    // function to do steps updates, returns the number of clusters in the last.
+    // Uses at most one thread per row of lattice
+    uint64_t sweep(L &lattice, const uint64_t steps = 1) {
+        if (lattice.sites() != m_parent.size()) {
+            if (lattice.sites() > std::numeric_limits<uint32_t>::max()) {
+                throw std::invalid_argument("Too many sites for SwendsenWang");
+            }
+            m_parent = std::vector<std::atomic<uint32_t>>(lattice.sites());
+        }
+        const uint32_t workers = std::min<uint64_t>(threads(), lattice.rows());
+
+        const uint64_t seed = m_rng[0]();
+        std::atomic<uint64_t> clusters{0};
+        Barrier barrier(workers);
+        std::vector<std::thread> pool;
+        for (uint32_t t = 1; t < workers; ++t) {
+            pool.emplace_back(&SwendsenWang::run, this, t, workers,
+                              std::ref(lattice), std::ref(barrier), steps,
+                              seed, std::ref(clusters));
+        }
+        run(0, workers, lattice, barrier, steps, seed, clusters);
+        for (std::thread &thread : pool) thread.join();
+        return clusters;
+    }
+
+    // function to change the inverse temperature
+    inline void set_beta(const double beta) {
+        if (beta < 0) throw std::invalid_argument("beta must be >= 0");
+        m_beta = beta;
+        m_add = threshold(1 - std::exp(-2 * beta));
+    }
+
+    inline double beta(void) const { return m_beta; }
+
+    inline uint32_t threads(void) const { return m_rng.size(); }
+
+    // constructor, by default one thread per core but at least one
+    explicit SwendsenWang(
+        const double beta,
+        const uint32_t threads =
+            std::max(1u, std::thread::hardware_concurrency()),
+        const uint64_t seed = 1) {
+        if (threads == 0) throw std::invalid_argument("Need threads >= 1");
+        set_beta(beta);
+        Xoshiro256 rng(seed);
+        for (uint32_t t = 0; t < threads; ++t) {
+            m_rng.push_back(rng);
+            rng.jump();
+        }
+    }
+};
+
+}  // namespace cj
+
+#endif  // ISINGCLUSTER_HPP
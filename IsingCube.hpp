@@ -0,0 +1,176 @@
+/**
+ * IsingCube.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * A periodic hypercubic lattice of N^D spins, e.g. the 3D cubic model, packed
+ * into 64 bit words along the last coordinate. Neighbour offsets are fixed at
+ * compile time from D and N.
+ */
+
+#ifndef ISINGCUBE_HPP
+#define ISINGCUBE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "BitKernels.hpp"
+
+namespace cj {
+
+// Class for a periodic N^D lattice, methods as IsingArray with D coordinates:
+// test(), high(), low(), flip(), adjacent(), count(), intrinisic(), and the
+// site interface, plus site(), row() and span(). Site (x0, ..., xD-1) is
+// s = ((x0 * N + x1) * N + ...) * N + xD-1, so IsingCube<2, N> numbers and
+// orders neighbours exactly as IsingArray<N>. Each row of N sites along the
+// last coordinate takes STRIDE whole words, as in IsingWords, for the multi
+// spin coded CubeMetropolis in IsingSweep.hpp. Coordinates are wrapped % N.
+template <uint32_t D, uint32_t N>
+class IsingCube {
+    static_assert(D >= 1, "Need at least one dimension");
+
+   public:
+    static const uint32_t STRIDE = words_for(N);  // words per row
+    static const uint32_t DEGREE = 2 * D;         // neighbours per site
+
+    // N^k, the site offset of a step along coordinate D - 1 - k
+    static constexpr uint64_t span(const uint32_t k) {
+        return k == 0 ? 1 : N * span(k - 1);
+    }
+
+   private:
+    std::vector<uint64_t> m_data;
+
+    // function to find the word and bit of site s
+    static inline uint64_t word(const uint64_t s) {
+        return s / N * STRIDE + (s % N >> WORD_SHIFT);
+    }
+    static inline uint64_t bit(const uint64_t s) {
+        return WORD_ONE << (s % N & WORD_MASK);
+    }
+
+   public:
+    // function to get the site index of coordinates x, each wrapped % N
+    template <class... I>
+    static inline uint64_t site(const I... x) {
+        static_assert(sizeof...(I) == D, "Need one coordinate per dimension");
+        const uint64_t xs[D] = {static_cast<uint64_t>(x)...};
+        uint64_t s = 0;
+        for (uint32_t k = 0; k < D; ++k) s = s * N + xs[k] % N;
+        return s;
+    }
+
+    // function to get the words of row r, the sites r * N to (r + 1) * N - 1
+    inline uint64_t *row(const uint64_t r) {
+        return m_data.data() + r * STRIDE;
+    }
+    inline const uint64_t *row(const uint64_t r) const {
+        return m_data.data() + r * STRIDE;
+    }
+
+    // functions to get val at coordinates x
+    template <class... I>
+    inline bool test(const I... x) const {
+        return test_site(site(x...));
+    }
+
+    // functions to set val at coordinates x to 1
+    template <class... I>
+    inline void high(const I... x) {
+        const uint64_t s = site(x...);
+        m_data[word(s)] |= bit(s);
+    }
+
+    // functions to set val at coordinates x to 0
+    template <class... I>
+    inline void low(const I... x) {
+        const uint64_t s = site(x...);
+        m_data[word(s)] &= ~bit(s);
+    }
+
+    // functions to swap val at coordinates x
+    template <class... I>
+    inline void flip(const I... x) {
+        flip_site(site(x...));
+    }
+
+    // function to see how many bits are set to 1 in next to coordinates x
+    template <class... I>
+    inline int adjacent(const I... x) const {
+        return adjacent_site(site(x...));
+    }
+
+    /*------------------------------Site index--------------------------------*/
+
+    static constexpr uint64_t sites(void) { return span(D); }
+
+    static constexpr uint64_t rows(void) { return span(D - 1); }
+
+    inline bool test_site(const uint64_t s) const {
+        return m_data[word(s)] & bit(s);
+    }
+
+    inline void flip_site(const uint64_t s) { m_data[word(s)] ^= bit(s); }
+
+    // function to write the sites next to s into out, the forward neighbour
+    // along coordinate k at out[2k] and the backward one at out[2k + 1]
+    inline void neighbours(const uint64_t s, uint64_t (&out)[DEGREE]) const {
+        for (uint32_t k = 0; k < D; ++k) {
+            const uint64_t step = span(D - 1 - k);
+            const uint64_t x = s / step % N;
+            out[2 * k] = x + 1 == N ? s - (N - 1) * step : s + step;
+            out[2 * k + 1] = x == 0 ? s + (N - 1) * step : s - step;
+        }
+    }
+
+    // function to see how many bits are set to 1 in next to site s
+    inline int adjacent_site(const uint64_t s) const {
+        uint64_t next[DEGREE];
+        neighbours(s, next);
+        int count = 0;
+        for (uint32_t k = 0; k < DEGREE; ++k) count += test_site(next[k]);
+        return count;
+    }
+
+    /*------------------------------------------------------------------------*/
+
+    // function to see how many bits are set to 1 in array
+    inline uint64_t count(void) const {
+        uint64_t count = 0;
+        for (const uint64_t w : m_data) count += popcount(w);
+        return count;
+    }
+
+    // function to find total intrinsic energy
+    inline double intrinisic(const double (&lookup)[DEGREE + 1][2]) const {
+        double tmp = 0;
+        for (uint64_t s = 0; s < sites(); ++s) {
+            tmp += lookup[adjacent_site(s)][test_site(s)];
+        }
+        return tmp;
+    }
+
+    // function to print row r on one line
+    void print(const uint64_t r) const {
+        std::cout << test_site(r * N);
+        for (uint32_t j = 1; j < N; ++j) {
+            std::cout << ',' << test_site(r * N + j);
+        }
+        std::cout << "\n";
+    }
+
+    // function to print all the rows
+    void print_all(void) const {
+        for (uint64_t r = 0; r < rows(); ++r) print(r);
+        std::cout << std::endl;
+    }
+
+    // constructor with every spin 0
+    IsingCube() : m_data(rows() * STRIDE) {}
+};
+
+}  // namespace cj
+
+#endif  // ISINGCUBE_HPP
@@ -0,0 +1,202 @@
+/**
+ * IsingLattice.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * An L*L periodic lattice of spins whose size is chosen at run time, so one
+ * binary can scan many sizes. The periodic wrap is a policy: a mask when L is
+ * a power of two, a division otherwise, and with_lattice() picks between them.
+ */
+
+#ifndef ISINGLATTICE_HPP
+#define ISINGLATTICE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "BitKernels.hpp"
+
+namespace cj {
+
+// Wrap policy for a power of two L, reduces with a mask and divides with a
+// shift
+class MaskWrap {
+    uint32_t m_mask;
+    uint32_t m_shift;
+
+   public:
+    static bool fits(const uint32_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+    // x % L and x / L
+    inline uint32_t operator()(const uint64_t x) const { return x & m_mask; }
+    inline uint64_t quot(const uint64_t x) const { return x >> m_shift; }
+
+    // constructor, checks n before the shift as __builtin_ctz(0) is undefined
+    explicit MaskWrap(const uint32_t n) : m_mask{n - 1} {
+        if (!fits(n)) throw std::invalid_argument("MaskWrap needs 2^k sites");
+        m_shift = __builtin_ctz(n);
+    }
+};
+
+// Wrap policy for any L using the hardware division
+class ModWrap {
+    uint32_t m_n;
+
+   public:
+    static bool fits(const uint32_t n) { return n != 0; }
+
+    // x % L and x / L
+    inline uint32_t operator()(const uint64_t x) const { return x % m_n; }
+    inline uint64_t quot(const uint64_t x) const { return x / m_n; }
+
+    // constructor
+    explicit ModWrap(const uint32_t n) : m_n{n} {
+        if (!fits(n)) throw std::invalid_argument("ModWrap needs n >= 1");
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for an L*L periodic lattice sized at run time, methods as IsingArray:
+// test(), high(), low(), flip(), adjacent(), count(), intrinisic(), the site
+// interface, plus size(), stride() and row(). Rows are stride() 64 bit words
+// in one allocation, laid out as in IsingWords so the multi spin coded
+// DynamicMetropolis in IsingSweep.hpp can update them a word at a time.
+template <class Wrap = ModWrap>
+class IsingLattice {
+    uint32_t m_n;
+    uint32_t m_stride;  // words per row
+    Wrap m_wrap;
+    std::vector<uint64_t> m_data;
+
+   public:
+    inline uint32_t size(void) const { return m_n; }
+    inline uint32_t stride(void) const { return m_stride; }
+
+    // function to get the words of row i
+    inline uint64_t *row(const uint32_t i) {
+        return m_data.data() + uint64_t(i) * m_stride;
+    }
+    inline const uint64_t *row(const uint32_t i) const {
+        return m_data.data() + uint64_t(i) * m_stride;
+    }
+
+    // functions to get val in i,j position
+    inline bool test(const uint32_t i, const uint32_t j) const {
+        const uint32_t c = m_wrap(j);
+        return (row(m_wrap(i))[c >> WORD_SHIFT] >> (c & WORD_MASK)) & 1;
+    }
+
+    // functions to set val in i,j position to 1
+    inline void high(const uint32_t i, const uint32_t j) {
+        const uint32_t c = m_wrap(j);
+        row(m_wrap(i))[c >> WORD_SHIFT] |= WORD_ONE << (c & WORD_MASK);
+    }
+
+    // functions to set val in i,j position to 0
+    inline void low(const uint32_t i, const uint32_t j) {
+        const uint32_t c = m_wrap(j);
+        row(m_wrap(i))[c >> WORD_SHIFT] &= ~(WORD_ONE << (c & WORD_MASK));
+    }
+
+    // functions to swap val in i,j position
+    inline void flip(const uint32_t i, const uint32_t j) {
+        const uint32_t c = m_wrap(j);
+        row(m_wrap(i))[c >> WORD_SHIFT] ^= WORD_ONE << (c & WORD_MASK);
+    }
+
+    // function to see how many bits are set to 1 in next to i,j
+    inline int adjacent(const uint32_t i, const uint32_t j) const {
+        int count = test(i + 1, j);
+        count += test(i - 1 + m_n, j);  //+m_n to stop % neg in test
+        count += test(i, j + 1);
+        count += test(i, j - 1 + m_n);
+        return count;
+    }
+
+    /*------------------------------Site index--------------------------------*/
+
+    static const uint32_t DEGREE = 4;  // neighbours per site
+
+    inline uint64_t sites(void) const { return uint64_t(m_n) * m_n; }
+
+    inline uint64_t rows(void) const { return m_n; }
+
+    inline bool test_site(const uint64_t s) const {
+        return test(m_wrap.quot(s), m_wrap(s));
+    }
+
+    inline void flip_site(const uint64_t s) { flip(m_wrap.quot(s), m_wrap(s)); }
+
+    // function to write the sites next to s into out, in the order of
+    // IsingArray::neighbours()
+    inline void neighbours(const uint64_t s, uint64_t (&out)[DEGREE]) const {
+        const uint64_t i = m_wrap.quot(s);
+        const uint64_t j = m_wrap(s);
+        out[0] = m_wrap(i + 1) * uint64_t(m_n) + j;
+        out[1] = m_wrap(i + m_n - 1) * uint64_t(m_n) + j;
+        out[2] = i * m_n + m_wrap(j + 1);
+        out[3] = i * m_n + m_wrap(j + m_n - 1);
+    }
+
+    /*------------------------------------------------------------------------*/
+
+    // function to see how many bits are set to 1 in array
+    inline uint64_t count(void) const {
+        uint64_t count = 0;
+        for (const uint64_t word : m_data) count += popcount(word);
+        return count;
+    }
+
+    // function to find total intrinsic energy
+    inline double intrinisic(const double (&lookup)[5][2]) const {
+        double tmp = 0;
+        for (uint32_t i = 0; i < m_n; ++i) {
+            for (uint32_t j = 0; j < m_n; ++j) {
+                tmp += lookup[adjacent(i, j)][test(i, j)];
+            }
+        }
+        return tmp;
+    }
+
+    // function to print the ith row on one line
+    void print(const uint32_t i) const {
+        std::cout << test(i, 0);
+        for (uint32_t j = 1; j < m_n; ++j) std::cout << ',' << test(i, j);
+        std::cout << "\n";
+    }
+
+    // function to print all the Ising array
+    void print_all(void) const {
+        for (uint32_t i = 0; i < m_n; ++i) print(i);
+        std::cout << std::endl;
+    }
+
+    // constructor for an n*n lattice with every spin 0
+    explicit IsingLattice(const uint32_t n)
+        : m_n{n},
+          m_stride(words_for(n)),
+          m_wrap(n),
+          m_data(uint64_t(m_stride) * n) {}
+};
+
+// function to call f with an n*n IsingLattice, using the mask wrap when n is
+// a power of two. f is called with either type, e.g. a generic lambda
+template <class F>
+auto with_lattice(const uint32_t n, F &&f)
+    -> decltype(f(std::declval<IsingLattice<ModWrap> &>())) {
+    if (MaskWrap::fits(n)) {
+        IsingLattice<MaskWrap> lattice(n);
+        return f(lattice);
+    }
+    IsingLattice<ModWrap> lattice(n);
+    return f(lattice);
+}
+
+}  // namespace cj
+
+#endif  // ISINGLATTICE_HPP
@@ -0,0 +1,148 @@
+/**
+ * IsingObservables.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Energy and magnetisation of a lattice kept up to date through every flip,
+ * so sampling them costs O(1) instead of a pass over the whole lattice.
+ */
+
+#ifndef ISINGOBSERVABLES_HPP
+#define ISINGOBSERVABLES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace cj {
+
+// Class wrapping a lattice L with the site index interface of IsingArray and
+// tracking its energy and magnetisation, methods: flip_site(), energy(),
+// magnetisation(), count(), recompute(), drift(), lattice(). The energy is
+// the sum over sites of lookup[adjacent][spin] as in IsingArray::intrinisic(),
+// a flip changes the terms of the site and its neighbours only. Every
+// interval flips the totals are recomputed from scratch and drift() records
+// the largest rounding error seen. It also has the site interface itself, so
+// e.g. Wolff<Observables<L>> tracks every cluster it flips. Not thread safe,
+// after an engine that writes the lattice directly call recompute().
+template <class L>
+class Observables {
+   public:
+    static const uint32_t DEGREE = L::DEGREE;
+
+   private:
+    L &m_lattice;
+    double m_lookup[DEGREE + 1][2];
+    double m_energy = 0;
+    uint64_t m_count = 0;  // spins set to 1
+    uint64_t m_flips = 0;
+    uint64_t m_interval;
+    double m_drift = 0;
+
+    // function to see how many sites next to s are set to 1
+    inline uint32_t adjacent(const uint64_t s) const {
+        uint64_t next[DEGREE];
+        m_lattice.neighbours(s, next);
+        uint32_t count = 0;
+        for (uint32_t k = 0; k < DEGREE; ++k) {
+            count += m_lattice.test_site(next[k]);
+        }
+        return count;
+    }
+
+   public:
+    // site interface forwarded to the lattice
+    inline uint64_t sites(void) const { return m_lattice.sites(); }
+    inline uint64_t rows(void) const { return m_lattice.rows(); }
+    inline bool test_site(const uint64_t s) const {
+        return m_lattice.test_site(s);
+    }
+    inline void neighbours(const uint64_t s, uint64_t (&out)[DEGREE]) const {
+        m_lattice.neighbours(s, out);
+    }
+
+    // function to flip site s updating the totals
+    inline void flip_site(const uint64_t s) {
+        const bool spin = m_lattice.test_site(s);
+        const uint32_t adj = adjacent(s);
+        double delta = m_lookup[adj][!spin] - m_lookup[adj][spin];
+
+        // each neighbour gains or loses one adjacent spin set to 1
+        uint64_t next[DEGREE];
+        m_lattice.neighbours(s, next);
+        for (uint32_t k = 0; k < DEGREE; ++k) {
+            const bool other = m_lattice.test_site(next[k]);
+            const uint32_t before = adjacent(next[k]);
+            const uint32_t after = spin ? before - 1 : before + 1;
+            delta += m_lookup[after][other] - m_lookup[before][other];
+        }
+
+        m_lattice.flip_site(s);
+        m_energy += delta;
+        m_count = spin ? m_count - 1 : m_count + 1;
+        if (++m_flips == m_interval) recompute();
+    }
+
+    // return the tracked totals
+    inline double energy(void) const { return m_energy; }
+    inline uint64_t count(void) const { return m_count; }
+    inline int64_t magnetisation(void) const {
+        return 2 * static_cast<int64_t>(m_count) -
+               static_cast<int64_t>(sites());
+    }
+
+    // function to recompute the totals from the lattice, returns how far the
+    // tracked energy had drifted
+    double recompute(void) {
+        double energy = 0;
+        uint64_t count = 0;
+        for (uint64_t s = 0; s < sites(); ++s) {
+            const bool spin = m_lattice.test_site(s);
+            energy += m_lookup[adjacent(s)][spin];
+            count += spin;
+        }
+        const double drift = std::fabs(energy - m_energy);
+        m_drift = std::max(m_drift, drift);
+        m_energy = energy;
+        m_count = count;
+        m_flips = 0;
+        return drift;
+    }
+
+    // return the largest drift found by recompute()
+    inline double drift(void) const { return m_drift; }
+
+    inline L &lattice(void) { return m_lattice; }
+
+    // constructor from a lookup table
+    Observables(L &lattice, const double (&lookup)[DEGREE + 1][2],
+                const uint64_t interval = uint64_t(1) << 24)
+        : m_lattice(lattice), m_interval{interval} {
+        std::copy(&lookup[0][0], &lookup[0][0] + 2 * (DEGREE + 1),
+                  &m_lookup[0][0]);
+        recompute();
+        m_drift = 0;
+    }
+
+    // constructor for coupling J and field h, each bond is split between its
+    // two sites: lookup[k][s] = -sigma * (J * (2k - DEGREE) / 2 + h) with
+    // sigma = 2s - 1
+    Observables(L &lattice, const double J, const double h,
+                const uint64_t interval = uint64_t(1) << 24)
+        : m_lattice(lattice), m_interval{interval} {
+        for (uint32_t k = 0; k <= DEGREE; ++k) {
+            for (int s = 0; s < 2; ++s) {
+                const double sigma = 2 * s - 1;
+                m_lookup[k][s] =
+                    -sigma * (J * (2.0 * k - DEGREE) / 2 + h);
+            }
+        }
+        recompute();
+        m_drift = 0;
+    }
+};
+
+}  // namespace cj
+
+#endif  // ISINGOBSERVABLES_HPP
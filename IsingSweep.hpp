@@ -0,0 +1,594 @@
+/**
+ * IsingSweep.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Multi spin coded Metropolis sweeps of an IsingWords, IsingHalo, IsingLattice
+ * or IsingCube. Each 64 bit word of a row is updated at once: the number of
+ * aligned neighbours of all 64 spins is summed with bit sliced adders and the
+ * accept decisions come from precomputed words of random bits. Sites are
+ * updated in a checkerboard so no spin changes while a neighbour is being
+ * decided, which also lets ParallelMetropolis split the rows of each colour
+ * across threads. ReplicaMetropolis instead codes 64 replicas of one site per
+ * word, see IsingReplicas.
+ */
+
+#ifndef ISINGSWEEP_HPP
+#define ISINGSWEEP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Barrier.hpp"
+#include "BitKernels.hpp"
+#include "IsingArray.hpp"
+#include "IsingCube.hpp"
+#include "IsingLattice.hpp"
+#include "Xoshiro.hpp"
+
+namespace cj {
+
+static const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+static const uint32_t MASK_POOL = 1 << 12;  // words in each accept pool
+
+// function to get a word whose bits are each 1 with probability p. Compares
+// 64 uniform numbers with p at once, one binary digit at a time, stopping
+// when every bit is decided (about 8 random words)
+template <class R>
+inline uint64_t bernoulli_word(R &rng, const double p) {
+    if (p <= 0) return 0;
+    if (p >= 1) return ~uint64_t(0);
+    const uint64_t q = static_cast<uint64_t>(std::ldexp(p, 64));
+    uint64_t out = 0;
+    uint64_t undecided = ~uint64_t(0);
+    for (int k = 63; k >= 0 && undecided != 0; --k) {
+        const uint64_t r = rng();
+        if ((q >> k) & 1) {
+            out |= undecided & ~r;  // digit of u is 0 so u < p
+            undecided &= r;
+        } else {
+            undecided &= ~r;  // digit of u is 1 so u > p
+        }
+    }
+    return out;
+}
+
+// function to get a word whose bit b is 1 with probability p_b, where bit b
+// of planes[k] is binary digit k of p_b in 64 bit fixed point. Only the bits
+// in need are decided, comparing a uniform number with each p_b one digit at
+// a time from the top and stopping once every bit is decided
+template <class R>
+inline uint64_t bernoulli_planes(R &rng, const uint64_t (&planes)[64],
+                                 uint64_t need) {
+    uint64_t out = 0;
+    for (int k = 63; k >= 0 && need != 0; --k) {
+        const uint64_t r = rng();
+        out |= need & planes[k] & ~r;  // digit of p is 1 and of u is 0
+        need &= ~(planes[k] ^ r);      // equal digits stay undecided
+    }
+    return out;
+}
+
+// function to get the sites of colour (i + j) % 2 == colour in word w of a
+// row of n sites
+inline uint64_t colour_mask(const uint32_t i, const uint32_t colour,
+                            const uint64_t w, const uint64_t n) {
+    const uint64_t mask = ((i ^ colour) & 1) ? ~EVEN_BITS : EVEN_BITS;
+    return w + 1 == words_for(n) ? mask & tail_mask(n) : mask;
+}
+
+// function to get the sites of colour (i + j) % 2 == colour in word w of row i
+template <uint32_t N>
+inline uint64_t colour_mask(const uint32_t i, const uint32_t colour,
+                            const uint64_t w) {
+    return colour_mask(i, colour, w, N);
+}
+
+// functions to sum the neighbours in next aligned with each spin of s, bit
+// sliced into s2 s1 s0
+inline void aligned(const uint64_t s, const uint64_t (&next)[4], uint64_t &s0,
+                    uint64_t &s1, uint64_t &s2) {
+    add4(~(s ^ next[0]), ~(s ^ next[1]), ~(s ^ next[2]), ~(s ^ next[3]), s0,
+         s1, s2);
+}
+
+inline void aligned(const uint64_t s, const uint64_t (&next)[6], uint64_t &s0,
+                    uint64_t &s1, uint64_t &s2) {
+    const uint64_t same[6] = {~(s ^ next[0]), ~(s ^ next[1]), ~(s ^ next[2]),
+                              ~(s ^ next[3]), ~(s ^ next[4]), ~(s ^ next[5])};
+    add6(same, s0, s1, s2);
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Class for the accept decisions of the checkerboard Metropolis engines with
+// J = 1 and no field on a lattice of D = 2 or 3 dimensions, methods: beta(),
+// set_beta(), refresh(), rng(). Flipping a spin with a of its 2D neighbours
+// aligned costs 4(a - D), so it is always accepted for a <= D and with
+// probability pk = exp(-4k beta) for a = D + k. The pk words are drawn from
+// pools of MASK_POOL words built by set_beta(), each draw rotated by a random
+// amount so a site sees every bit of the pool. A frozen pool would bias the
+// accept rate of each bit position, so after every row the oldest word of
+// each pool is replaced, which renews the pools every few sweeps.
+template <uint32_t D>
+class MultiSpin {
+    static_assert(D == 2 || D == 3, "Multi spin coding needs D = 2 or 3");
+
+    Xoshiro256 m_rng;
+    double m_beta;
+    double m_prob[D];             // exp(-4 beta), exp(-8 beta), ...
+    std::vector<uint64_t> m_pool;  // D pools of MASK_POOL words
+    uint32_t m_next = 0;           // oldest word in the pools
+
+    // function to rotate x left by k % 64 places
+    static inline uint64_t rotl(const uint64_t x, const uint64_t k) {
+        return (x << (k & 63)) | (x >> ((64 - k) & 63));
+    }
+
+    // function to draw a word of pool k using 18 bits of r
+    inline uint64_t draw(const uint32_t k, const uint64_t r) const {
+        return rotl(m_pool[k * MASK_POOL + ((r >> (12 * k)) & (MASK_POOL - 1))],
+                    r >> (12 * D + 6 * k));
+    }
+
+   protected:
+    // function to replace the oldest word of each pool
+    inline void renew(void) {
+        for (uint32_t k = 0; k < D; ++k) {
+            m_pool[k * MASK_POOL + m_next] = bernoulli_word(m_rng, m_prob[k]);
+        }
+        m_next = (m_next + 1) & (MASK_POOL - 1);
+    }
+
+    // function to get the accepted flips of the spins in s given the words
+    // holding their 2D neighbours
+    inline uint64_t accept(const uint64_t s, const uint64_t (&next)[2 * D]) {
+        uint64_t s0, s1, s2;
+        aligned(s, next, s0, s1, s2);
+
+        const uint64_t r = m_rng();
+        if (D == 2) {
+            // a = 3 is 011 and a = 4 is 100
+            return (s2 & draw(1, r)) | (~s2 & (~(s0 & s1) | draw(0, r)));
+        }
+        // a = 4, 5, 6 are 100, 101 and 110
+        return ~s2 | (~s1 & ((~s0 & draw(0, r)) | (s0 & draw(1, r)))) |
+               (s1 & draw(D - 1, r));
+    }
+
+    // function to get the accepted flips of the spins in s given the words
+    // holding their four neighbours in 2D
+    inline uint64_t accept(const uint64_t s, const uint64_t up,
+                           const uint64_t down, const uint64_t left,
+                           const uint64_t right) {
+        const uint64_t next[4] = {up, down, left, right};
+        return accept(s, next);
+    }
+
+   public:
+    // function to rebuild the accept pools with fresh random bits
+    void refresh(void) {
+        for (uint32_t k = 0; k < MASK_POOL; ++k) renew();
+    }
+
+    // function to change the inverse temperature
+    inline void set_beta(const double beta) {
+        if (beta < 0) throw std::invalid_argument("beta must be >= 0");
+        m_beta = beta;
+        for (uint32_t k = 0; k < D; ++k) {
+            m_prob[k] = std::exp(-4.0 * (k + 1) * beta);
+        }
+        refresh();
+    }
+
+    inline double beta(void) const { return m_beta; }
+
+    inline Xoshiro256 &rng(void) { return m_rng; }
+
+    // constructor taking a generator
+    MultiSpin(const double beta, const Xoshiro256 &rng)
+        : m_rng{rng}, m_beta{beta}, m_pool(D * MASK_POOL) {
+        set_beta(beta);
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for a checkerboard Metropolis engine on an N*N IsingWords or
+// IsingHalo, methods: sweep(), half_sweep(), update_row(), update_halo_row()
+// and those of MultiSpin. N must be even.
+template <uint32_t N>
+class Metropolis : public MultiSpin<2> {
+    static_assert(N % 2 == 0, "Checkerboard needs an even N");
+    static const uint32_t W = DenseBitsS<N>::length;
+
+    uint64_t m_left[W] = {};   // bit j holds spin j - 1
+    uint64_t m_right[W] = {};  // bit j holds spin j + 1
+
+   public:
+    // function to update the colour sites of row i given the rows above and
+    // below, safe in place as only sites of the other colour are read
+    inline void update_row(const uint64_t *up, uint64_t *row,
+                           const uint64_t *down, const uint32_t i,
+                           const uint32_t colour) {
+        rotl_words(m_left, row, N, 1);
+        rotr_words(m_right, row, N, 1);
+        for (uint64_t w = 0; w < W; ++w) {
+            const uint64_t s = row[w];
+            row[w] = s ^ (accept(s, up[w], down[w], m_left[w], m_right[w]) &
+                          colour_mask<N>(i, colour, w));
+        }
+        renew();
+    }
+
+    // function to update the colour sites of row i of an IsingHalo, whose
+    // ghost columns turn the rotations into plain shifts
+    inline void update_halo_row(const uint64_t *up, uint64_t *row,
+                                const uint64_t *down, const uint32_t i,
+                                const uint32_t colour) {
+        const uint32_t S = IsingHalo<N>::STRIDE;
+        const uint64_t mask = ((i ^ colour) & 1) ? EVEN_BITS : ~EVEN_BITS;
+        for (uint32_t w = 0; w < S; ++w) {
+            const uint64_t s = row[w];
+            const uint64_t left = (s << 1) | (w > 0 ? row[w - 1] >> 63 : 0);
+            const uint64_t right =
+                (s >> 1) | (w + 1 < S ? row[w + 1] << 63 : 0);
+            row[w] = s ^ (accept(s, up[w], down[w], left, right) & mask &
+                          IsingHalo<N>::interior(w));
+        }
+        renew();
+    }
+
+    // function to update every site of one colour
+    void half_sweep(IsingWords<N> &lattice, const uint32_t colour) {
+        for (uint32_t i = 0; i < N; ++i) {
+            update_row(lattice.array[(i + N - 1) % N].words(),
+                       lattice.array[i].words(),
+                       lattice.array[(i + 1) % N].words(), i, colour);
+        }
+    }
+
+    // function to update every site of one colour then refresh the ghosts
+    void half_sweep(IsingHalo<N> &lattice, const uint32_t colour) {
+        for (uint32_t i = 0; i < N; ++i) {
+            update_halo_row(lattice.row(i - 1), lattice.row(i),
+                            lattice.row(i + 1), i, colour);
+        }
+        lattice.refresh();
+    }
+
+    // function to attempt one flip of every site
+    template <class L>
+    inline void sweep(L &lattice) {
+        half_sweep(lattice, 0);
+        half_sweep(lattice, 1);
+    }
+
+    // constructor taking a generator
+    Metropolis(const double beta, const Xoshiro256 &rng)
+        : MultiSpin<2>(beta, rng) {}
+
+    // constructor
+    explicit Metropolis(const double beta, const uint64_t seed = 1)
+        : Metropolis(beta, Xoshiro256(seed)) {}
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for a checkerboard Metropolis engine on an IsingLattice sized at run
+// time, methods: sweep(), half_sweep(), update_row() and those of MultiSpin.
+// The same multi spin update as Metropolis with the row length and neighbour
+// buffers set by the lattice. The size must be even.
+class DynamicMetropolis : public MultiSpin<2> {
+    std::vector<uint64_t> m_left;   // bit j holds spin j - 1
+    std::vector<uint64_t> m_right;  // bit j holds spin j + 1
+
+   public:
+    // function to update the colour sites of row i of n sites given the rows
+    // above and below
+    inline void update_row(const uint64_t *up, uint64_t *row,
+                           const uint64_t *down, const uint32_t i,
+                           const uint32_t colour, const uint32_t n) {
+        const uint64_t words = words_for(n);
+        if (m_left.size() < words) {
+            m_left.resize(words);
+            m_right.resize(words);
+        }
+        rotl_words(m_left.data(), row, n, 1);
+        rotr_words(m_right.data(), row, n, 1);
+        for (uint64_t w = 0; w < words; ++w) {
+            const uint64_t s = row[w];
+            row[w] = s ^ (accept(s, up[w], down[w], m_left[w], m_right[w]) &
+                          colour_mask(i, colour, w, n));
+        }
+        renew();
+    }
+
+    // function to update every site of one colour
+    template <class Wrap>
+    void half_sweep(IsingLattice<Wrap> &lattice, const uint32_t colour) {
+        const uint32_t n = lattice.size();
+        if (n % 2 != 0) {
+            throw std::invalid_argument("Checkerboard needs an even size");
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            update_row(lattice.row(i == 0 ? n - 1 : i - 1), lattice.row(i),
+                       lattice.row(i + 1 == n ? 0 : i + 1), i, colour, n);
+        }
+    }
+
+    // function to attempt one flip of every site
+    template <class Wrap>
+    inline void sweep(IsingLattice<Wrap> &lattice) {
+        half_sweep(lattice, 0);
+        half_sweep(lattice, 1);
+    }
+
+    // constructor taking a generator
+    DynamicMetropolis(const double beta, const Xoshiro256 &rng)
+        : MultiSpin<2>(beta, rng) {}
+
+    // constructor
+    explicit DynamicMetropolis(const double beta, const uint64_t seed = 1)
+        : DynamicMetropolis(beta, Xoshiro256(seed)) {}
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for a checkerboard Metropolis engine on an IsingCube<D, N> with D = 2
+// or 3, methods: sweep(), half_sweep(), update_row() and those of MultiSpin.
+// The colour of a site is the parity of the sum of its coordinates, so a row
+// is coloured as row i of IsingWords with i the parity of its other
+// coordinates. In 3D the six neighbour counts are summed with add6. N must
+// be even.
+template <uint32_t D, uint32_t N>
+class CubeMetropolis : public MultiSpin<D> {
+    static_assert(N % 2 == 0, "Checkerboard needs an even N");
+    static const uint32_t W = IsingCube<D, N>::STRIDE;
+
+    uint64_t m_left[W] = {};   // bit j holds spin j - 1
+    uint64_t m_right[W] = {};  // bit j holds spin j + 1
+
+   public:
+    // function to update the colour sites of a row whose other coordinates
+    // sum to parity, given its neighbouring rows in the order of
+    // IsingCube::neighbours()
+    inline void update_row(const uint64_t *const (&next)[2 * D - 2],
+                           uint64_t *row, const uint32_t parity,
+                           const uint32_t colour) {
+        rotl_words(m_left, row, N, 1);
+        rotr_words(m_right, row, N, 1);
+        uint64_t words[2 * D];
+        for (uint64_t w = 0; w < W; ++w) {
+            for (uint32_t k = 0; k + 2 < 2 * D; ++k) words[k] = next[k][w];
+            words[2 * D - 2] = m_left[w];
+            words[2 * D - 1] = m_right[w];
+            const uint64_t s = row[w];
+            row[w] = s ^ (this->accept(s, words) &
+                          colour_mask<N>(parity, colour, w));
+        }
+        this->renew();
+    }
+
+    // function to update every site of one colour
+    void half_sweep(IsingCube<D, N> &lattice, const uint32_t colour) {
+        const uint64_t *next[2 * D - 2];
+        for (uint64_t r = 0; r < lattice.rows(); ++r) {
+            uint32_t parity = 0;
+            for (uint32_t k = 0; k + 1 < D; ++k) {
+                const uint64_t step = IsingCube<D, N>::span(D - 2 - k);
+                const uint64_t x = r / step % N;
+                parity += x;
+                next[2 * k] =
+                    lattice.row(x + 1 == N ? r - (N - 1) * step : r + step);
+                next[2 * k + 1] =
+                    lattice.row(x == 0 ? r + (N - 1) * step : r - step);
+            }
+            update_row(next, lattice.row(r), parity & 1, colour);
+        }
+    }
+
+    // function to attempt one flip of every site
+    inline void sweep(IsingCube<D, N> &lattice) {
+        half_sweep(lattice, 0);
+        half_sweep(lattice, 1);
+    }
+
+    // constructor taking a generator
+    CubeMetropolis(const double beta, const Xoshiro256 &rng)
+        : MultiSpin<D>(beta, rng) {}
+
+    // constructor
+    explicit CubeMetropolis(const double beta, const uint64_t seed = 1)
+        : CubeMetropolis(beta, Xoshiro256(seed)) {}
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for a Metropolis engine on the 64 replicas of an IsingReplicas, each
+// at its own beta with J = 1 and no field, methods: sweep(), update_site(),
+// beta(), set_beta(), rng(). Sites are visited in order and each word update
+// decides the flip of one site in all 64 replicas: flips with a <= 2 aligned
+// neighbours are always accepted, those with a = 3 or 4 with probability
+// exp(-4 beta_b) or exp(-8 beta_b) from bernoulli_planes(), which draws only
+// for the replicas that need it. The replicas share one generator but no
+// random bits, so they evolve independently.
+template <uint32_t N>
+class ReplicaMetropolis {
+    static const uint32_t R = IsingReplicas<N>::REPLICAS;
+
+    Xoshiro256 m_rng;
+    double m_beta[R];
+    uint64_t m_p1[64];  // bit planes of exp(-4 beta_b)
+    uint64_t m_p2[64];  // bit planes of exp(-8 beta_b)
+
+    // function to rebuild the bit planes from m_beta
+    void planes(void) {
+        for (uint32_t b = 0; b < R; ++b) {
+            m_p1[b] = threshold(std::exp(-4 * m_beta[b]));
+            m_p2[b] = threshold(std::exp(-8 * m_beta[b]));
+        }
+        transpose64(m_p1);
+        transpose64(m_p2);
+    }
+
+   public:
+    // function to update the spin at s in every replica given its neighbours
+    inline void update_site(uint64_t &s, const uint64_t up, const uint64_t down,
+                            const uint64_t left, const uint64_t right) {
+        uint64_t s0, s1, s2;
+        add4(~(s ^ up), ~(s ^ down), ~(s ^ left), ~(s ^ right), s0, s1, s2);
+        s ^= ~(s2 | (s0 & s1)) |
+             bernoulli_planes(m_rng, m_p1, ~s2 & s0 & s1) |
+             bernoulli_planes(m_rng, m_p2, s2);
+    }
+
+    // function to attempt one flip of every site of every replica
+    void sweep(IsingReplicas<N> &lattice) {
+        for (uint32_t i = 0; i < N; ++i) {
+            const uint64_t *up = lattice.row(i == 0 ? N - 1 : i - 1);
+            uint64_t *row = lattice.row(i);
+            const uint64_t *down = lattice.row(i + 1 == N ? 0 : i + 1);
+            for (uint32_t j = 0; j < N; ++j) {
+                update_site(row[j], up[j], down[j], row[j == 0 ? N - 1 : j - 1],
+                            row[j + 1 == N ? 0 : j + 1]);
+            }
+        }
+    }
+
+    // functions to change the inverse temperature of replica b or of all
+    inline void set_beta(const uint32_t b, const double beta) {
+        if (beta < 0) throw std::invalid_argument("beta must be >= 0");
+        m_beta[b] = beta;
+        planes();
+    }
+    inline void set_beta(const double beta) {
+        if (beta < 0) throw std::invalid_argument("beta must be >= 0");
+        std::fill(m_beta, m_beta + R, beta);
+        planes();
+    }
+
+    inline double beta(const uint32_t b) const { return m_beta[b]; }
+
+    inline Xoshiro256 &rng(void) { return m_rng; }
+
+    // constructor for one beta per replica
+    ReplicaMetropolis(const std::vector<double> &betas,
+                      const uint64_t seed = 1)
+        : m_rng(seed) {
+        if (betas.size() != R) throw std::invalid_argument("Need 64 betas");
+        for (const double beta : betas) {
+            if (beta < 0) throw std::invalid_argument("beta must be >= 0");
+        }
+        std::copy(betas.begin(), betas.end(), m_beta);
+        planes();
+    }
+
+    // constructor for every replica at beta
+    explicit ReplicaMetropolis(const double beta, const uint64_t seed = 1)
+        : m_rng(seed) {
+        set_beta(beta);
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// Class for checkerboard Metropolis sweeps split across threads, methods:
+// sweep(), beta(), set_beta(), threads(). Thread t owns a block of rows and a
+// Metropolis engine whose generator is t jump()s from the seed. For each
+// colour a thread copies the two rows bordering its block, waits for every
+// other thread, updates its block and waits again, so no thread reads a row
+// while another writes it.
+template <uint32_t N>
+class ParallelMetropolis {
+    static const uint32_t W = DenseBitsS<N>::length;
+
+    struct Worker {
+        Metropolis<N> engine;
+        uint32_t begin;
+        uint32_t end;
+        uint64_t up[W];    // copy of row begin - 1
+        uint64_t down[W];  // copy of row end
+    };
+
+    std::vector<Worker> m_workers;
+
+    void run(Worker &worker, IsingWords<N> &lattice, Barrier &barrier,
+             const uint64_t sweeps) {
+        const uint32_t begin = worker.begin;
+        const uint32_t end = worker.end;
+        for (uint64_t s = 0; s < sweeps; ++s) {
+            for (uint32_t colour = 0; colour < 2; ++colour) {
+                const uint64_t *above =
+                    lattice.array[(begin + N - 1) % N].words();
+                const uint64_t *below = lattice.array[end % N].words();
+                std::copy(above, above + W, worker.up);
+                std::copy(below, below + W, worker.down);
+                barrier.wait();
+
+                for (uint32_t i = begin; i < end; ++i) {
+                    worker.engine.update_row(
+                        i == begin ? worker.up : lattice.array[i - 1].words(),
+                        lattice.array[i].words(),
+                        i + 1 == end ? worker.down
+                                     : lattice.array[i + 1].words(),
+                        i, colour);
+                }
+                barrier.wait();
+            }
+        }
+    }
+
+   public:
+    // function to attempt sweeps flips of every site
+    void sweep(IsingWords<N> &lattice, const uint64_t sweeps = 1) {
+        Barrier barrier(threads());
+        std::vector<std::thread> pool;
+        for (uint32_t t = 1; t < threads(); ++t) {
+            pool.emplace_back(&ParallelMetropolis::run, this,
+                              std::ref(m_workers[t]), std::ref(lattice),
+                              std::ref(barrier), sweeps);
+        }
+        run(m_workers[0], lattice, barrier, sweeps);
+        for (std::thread &thread : pool) thread.join();
+    }
+
+    // function to change the inverse temperature of every thread
+    void set_beta(const double beta) {
+        for (Worker &worker : m_workers) worker.engine.set_beta(beta);
+    }
+
+    inline double beta(void) const { return m_workers[0].engine.beta(); }
+
+    inline uint32_t threads(void) const { return m_workers.size(); }
+
+    // constructor, by default one thread per core but at least one and at
+    // most N
+    explicit ParallelMetropolis(
+        const double beta,
+        const uint32_t threads =
+            std::min(N, std::max(1u, std::thread::hardware_concurrency())),
+        const uint64_t seed = 1) {
+        if (threads == 0 || threads > N) {
+            throw std::invalid_argument("Need 1 <= threads <= N");
+        }
+        Xoshiro256 rng(seed);
+        m_workers.reserve(threads);
+        for (uint32_t t = 0; t < threads; ++t) {
+            m_workers.push_back(Worker{Metropolis<N>(beta, rng),
+                                       t * N / threads, (t + 1) * N / threads,
+                                       {}, {}});
+            rng.jump();
+        }
+    }
+};
+
+}  // namespace cj
+
+#endif  // ISINGSWEEP_HPP
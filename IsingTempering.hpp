@@ -0,0 +1,177 @@
+/**
+ * IsingTempering.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Parallel tempering (replica exchange) of Ising lattices. Replicas at
+ * neighbouring temperatures swap temperatures now and then, so a replica
+ * stuck at low temperature can escape by heating up and cooling again.
+ */
+
+#ifndef ISINGTEMPERING_HPP
+#define ISINGTEMPERING_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Barrier.hpp"
+#include "Xoshiro.hpp"
+
+namespace cj {
+
+// function to find the energy with J = 1 and no field of a lattice with the
+// site index interface, counting each bond once through its forward end
+template <class L>
+int64_t bond_energy(const L &lattice) {
+    int64_t aligned = 0;
+    uint64_t next[L::DEGREE];
+    for (uint64_t s = 0; s < lattice.sites(); ++s) {
+        const bool spin = lattice.test_site(s);
+        lattice.neighbours(s, next);
+        for (uint32_t d = 0; d < L::DEGREE; d += 2) {
+            aligned += lattice.test_site(next[d]) == spin;
+        }
+    }
+    const int64_t bonds = lattice.sites() * (L::DEGREE / 2);
+    return bonds - 2 * aligned;
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Class for parallel tempering of M replicas of lattice L, methods: run(),
+// lattice(), replica(), beta(), energy(), attempts(), accepted(),
+// acceptance(), reset(), size(), threads(). Temperature t has its own Engine
+// at inverse temperature beta(t), e.g. Metropolis<N> or Wolff<L>, which
+// sweeps whichever replica holds t. A swap between t and t + 1 exchanges only
+// the labels saying which replica is where, never lattice data, and is
+// accepted with probability min(1, exp((beta_t - beta_t+1)(E_t - E_t+1))).
+// Each round every thread sweeps the replicas of its block of temperatures
+// and finds their energies, then swaps are tried on even pairs (0, 1),
+// (2, 3), ... in even rounds and odd pairs (1, 2), ... in odd rounds.
+template <class L, class Engine>
+class Tempering {
+    std::vector<L> m_lattice;          // replica r
+    std::vector<Engine> m_engine;      // temperature t
+    std::vector<double> m_beta;        // temperature t
+    std::vector<uint32_t> m_replica;   // replica at temperature t
+    std::vector<int64_t> m_energy;     // of the replica at temperature t
+    std::vector<uint64_t> m_attempts;  // pair t, t + 1
+    std::vector<uint64_t> m_accepted;
+    Xoshiro256 m_rng;  // for the swaps
+    uint32_t m_threads;
+    uint64_t m_round = 0;
+
+    // function to try swapping the replicas at every other pair
+    void swap(void) {
+        for (uint32_t t = m_round & 1; t + 1 < size(); t += 2) {
+            ++m_attempts[t];
+            const double x =
+                (m_beta[t] - m_beta[t + 1]) * (m_energy[t] - m_energy[t + 1]);
+            if (x >= 0 || m_rng.uniform() < std::exp(x)) {
+                ++m_accepted[t];
+                std::swap(m_replica[t], m_replica[t + 1]);
+                std::swap(m_energy[t], m_energy[t + 1]);
+            }
+        }
+        ++m_round;
+    }
+
+    void work(const uint32_t k, Barrier &barrier, const uint64_t rounds,
+              const uint64_t sweeps) {
+        const uint32_t begin = k * size() / m_threads;
+        const uint32_t end = (k + 1) * size() / m_threads;
+        for (uint64_t n = 0; n < rounds; ++n) {
+            for (uint32_t t = begin; t < end; ++t) {
+                L &lattice = m_lattice[m_replica[t]];
+                for (uint64_t s = 0; s < sweeps; ++s) {
+                    m_engine[t].sweep(lattice);
+                }
+                m_energy[t] = bond_energy(lattice);
+            }
+            barrier.wait();
+            if (k == 0) swap();
+            barrier.wait();
+        }
+    }
+
+   public:
+    // function to do rounds of sweeps sweeps of every replica each followed
+    // by one pass of swaps
+    void run(const uint64_t rounds, const uint64_t sweeps = 1) {
+        Barrier barrier(m_threads);
+        std::vector<std::thread> pool;
+        for (uint32_t k = 1; k < m_threads; ++k) {
+            pool.emplace_back(&Tempering::work, this, k, std::ref(barrier),
+                              rounds, sweeps);
+        }
+        work(0, barrier, rounds, sweeps);
+        for (std::thread &thread : pool) thread.join();
+    }
+
+    // functions to get the replica at temperature t and its lattice
+    inline uint32_t replica(const uint32_t t) const { return m_replica[t]; }
+    inline L &lattice(const uint32_t t) { return m_lattice[m_replica[t]]; }
+    inline const L &lattice(const uint32_t t) const {
+        return m_lattice[m_replica[t]];
+    }
+
+    inline double beta(const uint32_t t) const { return m_beta[t]; }
+
+    // function to get the energy of the replica at t after the last round
+    inline int64_t energy(const uint32_t t) const { return m_energy[t]; }
+
+    // functions to get the swap statistics of the pair t, t + 1
+    inline uint64_t attempts(const uint32_t t) const { return m_attempts[t]; }
+    inline uint64_t accepted(const uint32_t t) const { return m_accepted[t]; }
+    inline double acceptance(const uint32_t t) const {
+        return m_attempts[t] ? double(m_accepted[t]) / m_attempts[t] : 0;
+    }
+
+    // function to clear the swap statistics, e.g. after equilibration
+    void reset(void) {
+        std::fill(m_attempts.begin(), m_attempts.end(), 0);
+        std::fill(m_accepted.begin(), m_accepted.end(), 0);
+    }
+
+    inline uint32_t size(void) const { return m_beta.size(); }
+
+    inline uint32_t threads(void) const { return m_threads; }
+
+    // constructor for one replica at each of betas, all copies of lattice,
+    // using at most one thread per replica, by default one per core but at
+    // least one. The engines and the swaps use streams jump()ed apart from
+    // seed
+    explicit Tempering(
+        const std::vector<double> &betas, const L &lattice = L(),
+        const uint32_t threads =
+            std::max(1u, std::thread::hardware_concurrency()),
+        const uint64_t seed = 1)
+        : m_lattice(betas.size(), lattice),
+          m_beta(betas),
+          m_replica(betas.size()),
+          m_energy(betas.size(), bond_energy(lattice)),
+          m_attempts(betas.size()),
+          m_accepted(betas.size()),
+          m_rng(seed),
+          m_threads(std::min<uint64_t>(threads, betas.size())) {
+        if (betas.size() < 2) throw std::invalid_argument("Need 2+ replicas");
+        if (threads == 0) throw std::invalid_argument("Need threads >= 1");
+        m_engine.reserve(betas.size());
+        for (uint32_t t = 0; t < size(); ++t) {
+            m_replica[t] = t;
+            m_rng.jump();
+            m_engine.emplace_back(betas[t], m_rng);
+        }
+        m_rng.jump();
+    }
+};
+
+}  // namespace cj
+
+#endif  // ISINGTEMPERING_HPP
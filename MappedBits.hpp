@@ -0,0 +1,263 @@
+/**
+ * MappedBits.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Binary save() and load() for the dense bit sets and MappedBits, a read only
+ * view of a saved set that maps the file instead of copying it. A file is a
+ * 32 byte BitsHeader followed by the set as little endian 64 bit words, which
+ * is also the byte layout of DenseBitsH, so every set type reads every file.
+ */
+
+#ifndef MAPPEDBITS_HPP
+#define MAPPEDBITS_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "BitKernels.hpp"
+#include "DenseBits.hpp"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "MappedBits.hpp assumes a little endian host"
+#endif
+
+namespace cj {
+
+static const char BITS_MAGIC[8] = {'C', 'J', 'B', 'I', 'T', 'S', 0, 0};
+static const uint32_t BITS_VERSION = 1;
+
+// Struct at the start of every saved bit set
+struct BitsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t word_bytes;  // always 8
+    uint64_t n_bits;
+    uint64_t n_words;  // words that follow the header
+};
+
+static_assert(sizeof(BitsHeader) == 32, "BitsHeader must be 32 bytes");
+static_assert(sizeof(ByteOfBits) == 1, "DenseBitsH must be plain bytes");
+
+// function to build the header for a set of n_bits
+inline BitsHeader bits_header(const uint64_t n_bits) {
+    BitsHeader head;
+    std::memcpy(head.magic, BITS_MAGIC, sizeof(BITS_MAGIC));
+    head.version = BITS_VERSION;
+    head.word_bytes = 8;
+    head.n_bits = n_bits;
+    head.n_words = words_for(n_bits);
+    return head;
+}
+
+// function to throw if head is not a header this file can read
+inline void check_header(const BitsHeader &head, const std::string &path) {
+    if (std::memcmp(head.magic, BITS_MAGIC, sizeof(BITS_MAGIC)) != 0 ||
+        head.version != BITS_VERSION || head.word_bytes != 8 ||
+        head.n_words != words_for(head.n_bits)) {
+        throw invalid_argument("Not a saved bit set: " + path);
+    }
+}
+
+// function to write n_bytes of packed bits as a file, zero padded to a whole
+// number of words
+inline void save_bytes(const std::string &path, const void *bytes,
+                       const uint64_t n_bytes, const uint64_t n_bits) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) throw invalid_argument("Could not open " + path);
+
+    const BitsHeader head = bits_header(n_bits);
+    const char pad[8] = {};
+    file.write(reinterpret_cast<const char *>(&head), sizeof(head));
+    file.write(static_cast<const char *>(bytes), n_bytes);
+    file.write(pad, head.n_words * 8 - n_bytes);
+    if (!file) throw invalid_argument("Could not write " + path);
+}
+
+// function to open a saved set and read its header
+inline BitsHeader read_header(std::ifstream &file, const std::string &path) {
+    if (!file) throw invalid_argument("Could not open " + path);
+    BitsHeader head;
+    if (!file.read(reinterpret_cast<char *>(&head), sizeof(head))) {
+        throw invalid_argument("Not a saved bit set: " + path);
+    }
+    check_header(head, path);
+    return head;
+}
+
+// function to read the first n_bytes of a saved set of n_bits into bytes
+inline void load_bytes(const std::string &path, void *bytes,
+                       const uint64_t n_bytes, const uint64_t n_bits) {
+    std::ifstream file(path, std::ios::binary);
+    if (read_header(file, path).n_bits != n_bits) {
+        throw invalid_argument("Saved set is a different size: " + path);
+    }
+    if (!file.read(static_cast<char *>(bytes), n_bytes)) {
+        throw invalid_argument("Saved set is truncated: " + path);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+
+// functions to save and load a DenseBitsH, the bytes are copied in one go
+template <uint32_t size>
+void save(const std::string &path, const DenseBitsH<size> &bits) {
+    save_bytes(path, bits.set, DenseBitsH<size>::length, size);
+}
+
+template <uint32_t size>
+void load(const std::string &path, DenseBitsH<size> &bits) {
+    load_bytes(path, bits.set, DenseBitsH<size>::length, size);
+    if (size & MASK) {
+        unsigned char *last =
+            reinterpret_cast<unsigned char *>(bits.set) + bits.length - 1;
+        *last &= (1U << (size & MASK)) - 1;
+    }
+}
+
+// functions to save and load any word bit set, load() needs a set of the
+// saved size
+template <class E>
+void save(const std::string &path, const WordBits<E> &bits) {
+    E const &self = static_cast<E const &>(bits);
+    save_bytes(path, self.words(), self.n_words() * 8, self.n_bits());
+}
+
+template <class E>
+void load(const std::string &path, WordBits<E> &bits) {
+    E &self = static_cast<E &>(bits);
+    load_bytes(path, self.words(), self.n_words() * 8, self.n_bits());
+    if (self.n_words() != 0) {
+        self.words()[self.n_words() - 1] &= tail_mask(self.n_bits());
+    }
+}
+
+// function to load a saved set of any size, resizing bits to match
+inline void load(const std::string &path, DynamicBits &bits) {
+    std::ifstream file(path, std::ios::binary);
+    const BitsHeader head = read_header(file, path);
+    bits.resize(head.n_bits);
+    if (!file.read(reinterpret_cast<char *>(bits.words()), head.n_words * 8)) {
+        throw invalid_argument("Saved set is truncated: " + path);
+    }
+    if (head.n_words != 0) {
+        bits.words()[head.n_words - 1] &= tail_mask(head.n_bits);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Class for a read only view of a saved bit set, the file is mapped shared so
+// every process viewing it uses the same page cache copy and nothing is read
+// until it is touched. Has the const WordBits methods: test(), count(),
+// find_first(), find_next(), ones(), print() etc. and advise(). Does not wrap
+// bit indices.
+class MappedBits : public WordBits<MappedBits> {
+    void *m_base = nullptr;
+    uint64_t m_bytes = 0;
+    const uint64_t *m_set = nullptr;
+    uint64_t m_bits = 0;
+
+    inline void unmap(void) {
+        if (m_base != nullptr) munmap(m_base, m_bytes);
+        m_base = nullptr;
+        m_set = nullptr;
+    }
+
+   public:
+    inline const uint64_t *words(void) const { return m_set; }
+    inline uint64_t n_words(void) const { return words_for(m_bits); }
+    inline uint64_t n_bits(void) const { return m_bits; }
+    static inline uint64_t index(const uint64_t bit) { return bit; }
+
+    // return number of bits in the set
+    inline uint64_t size(void) const { return m_bits; }
+
+    // function to hint the expected access pattern to the kernel, e.g.
+    // MADV_SEQUENTIAL before a scan or MADV_RANDOM for point queries
+    inline void advise(const int advice) const {
+        if (m_base != nullptr) madvise(m_base, m_bytes, advice);
+    }
+
+    // constructor
+    explicit MappedBits(const std::string &path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw invalid_argument("Could not open " + path);
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 ||
+            static_cast<uint64_t>(info.st_size) < sizeof(BitsHeader)) {
+            close(fd);
+            throw invalid_argument("Not a saved bit set: " + path);
+        }
+        m_bytes = info.st_size;
+        m_base = mmap(nullptr, m_bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (m_base == MAP_FAILED) {
+            m_base = nullptr;
+            throw invalid_argument("Could not map " + path);
+        }
+
+        BitsHeader head;
+        std::memcpy(&head, m_base, sizeof(head));
+        try {
+            check_header(head, path);
+            if (sizeof(head) + head.n_words * 8 > m_bytes) {
+                throw invalid_argument("Saved set is truncated: " + path);
+            }
+        } catch (...) {
+            unmap();
+            throw;
+        }
+        m_bits = head.n_bits;
+        m_set = reinterpret_cast<const uint64_t *>(
+            static_cast<const char *>(m_base) + sizeof(head));
+    }
+
+    // de-constructor
+    ~MappedBits(void) { unmap(); }
+
+    // the view is not copied
+    MappedBits(MappedBits const &other) = delete;
+    MappedBits &operator=(const MappedBits &other) = delete;
+
+    // move constructor
+    MappedBits(MappedBits &&other) noexcept
+        : m_base{other.m_base},
+          m_bytes{other.m_bytes},
+          m_set{other.m_set},
+          m_bits{other.m_bits} {
+        other.m_base = nullptr;
+        other.m_set = nullptr;
+        other.m_bytes = other.m_bits = 0;
+    }
+
+    // move operator
+    MappedBits &operator=(MappedBits &&other) noexcept {
+        if (this != &other) {
+            unmap();
+            m_base = other.m_base;
+            m_bytes = other.m_bytes;
+            m_set = other.m_set;
+            m_bits = other.m_bits;
+            other.m_base = nullptr;
+            other.m_set = nullptr;
+            other.m_bytes = other.m_bits = 0;
+        }
+        return *this;
+    }
+};
+
+}  // namespace cj
+
+#endif  // MAPPEDBITS_HPP
@@ -0,0 +1,183 @@
+/**
+ * RankSelect.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Succinct rank/select index over a word based bit set, laid out like poppy
+ * (Zhou, Andersen and Kaminsky). Every 2048 bit block has one 64 bit entry
+ * holding the number of ones before the block and the counts of its first
+ * three 512 bit sub-blocks. The position of every 8192^th one is sampled to
+ * start select. The index adds a little over 3% to the bit set, mostly the
+ * one entry per block. Bit sets are limited to 2^32 - 1 bits.
+ */
+
+#ifndef RANKSELECT_HPP
+#define RANKSELECT_HPP
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "BitKernels.hpp"
+#include "DenseBits.hpp"
+
+namespace cj {
+
+static const uint32_t RS_BLOCK_SHIFT = 11;  // 2048 bits per block
+static const uint32_t RS_SUB_SHIFT = 9;     // 512 bits per sub-block
+static const uint32_t RS_BLOCK_WORDS = 32;
+static const uint32_t RS_SUB_WORDS = 8;
+static const uint32_t RS_SAMPLE_SHIFT = 13;  // sample every 8192 ones
+
+// Class to answer rank(i), the number of ones before bit i, in constant time
+// and select(k), the position of the k^th one, in near constant time. The
+// index refers to the bit set's words and must be rebuilt with build() after
+// the bit set changes. Methods: build(), rank(), rank0(), select(), count().
+class RankSelect {
+    const uint64_t *m_words = nullptr;
+    uint32_t m_bits = 0;
+    uint32_t m_length = 0;
+    uint32_t m_ones = 0;
+
+    std::vector<uint64_t> m_blocks;   // cumulative count | 3 x 10 bit counts
+    std::vector<uint32_t> m_samples;  // block holding every 8192^th one
+
+    // number of ones before block b
+    inline uint32_t before(const uint32_t b) const {
+        return static_cast<uint32_t>(m_blocks[b]);
+    }
+
+    // number of ones in sub-block s (0, 1 or 2) of block b
+    inline uint32_t sub_count(const uint32_t b, const uint32_t s) const {
+        return (m_blocks[b] >> (32 + 10 * s)) & 1023;
+    }
+
+    // number of ones in words [from, to), reading nothing past the set
+    inline uint32_t ones_in(uint32_t from, uint32_t to) const {
+        if (to > m_length) to = m_length;
+        uint32_t count = 0;
+        for (; from < to; ++from) {
+            count += popcount(m_words[from]);
+        }
+        return count;
+    }
+
+    // function to check a bit set's length fits the 32 bit counts
+    static inline uint32_t checked(const uint64_t bits) {
+        if (bits > std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument("RankSelect needs < 2^32 bits");
+        }
+        return static_cast<uint32_t>(bits);
+    }
+
+   public:
+    RankSelect(const uint64_t *words, const uint32_t bits)
+        : m_words{words}, m_bits{bits}, m_length{static_cast<uint32_t>(
+                                            words_for(bits))} {
+        build();
+    }
+
+    template <class E>
+    explicit RankSelect(const WordBits<E> &bits)
+        : RankSelect(static_cast<E const &>(bits).words(),
+                     checked(static_cast<E const &>(bits).n_bits())) {}
+
+    // function to (re)build the index from the bit set
+    void build(void) {
+        const uint32_t blocks =
+            (m_length + RS_BLOCK_WORDS - 1) / RS_BLOCK_WORDS;
+
+        m_blocks.assign(blocks + 1, 0);
+        m_samples.clear();
+
+        uint32_t total = 0;
+        for (uint32_t b = 0; b < blocks; ++b) {
+            uint64_t entry = total;
+            uint32_t w = b * RS_BLOCK_WORDS;
+            for (uint32_t s = 0; s < 4; ++s, w += RS_SUB_WORDS) {
+                uint32_t count = ones_in(w, w + RS_SUB_WORDS);
+                // sample every block where a multiple of 8192 ones is reached
+                while ((static_cast<uint64_t>(m_samples.size())
+                        << RS_SAMPLE_SHIFT) < total + count) {
+                    m_samples.push_back(b);
+                }
+                if (s < 3) {
+                    entry |= static_cast<uint64_t>(count) << (32 + 10 * s);
+                }
+                total += count;
+            }
+            m_blocks[b] = entry;
+        }
+        m_blocks[blocks] = total;
+        m_samples.push_back(blocks == 0 ? 0 : blocks - 1);
+        m_ones = total;
+    }
+
+    // function to count ones in bits [0, i), 0 <= i <= size
+    inline uint32_t rank(const uint32_t i) const {
+        const uint32_t b = i >> RS_BLOCK_SHIFT;
+        const uint32_t s = (i >> RS_SUB_SHIFT) & 3;
+
+        uint32_t count = before(b);
+        for (uint32_t k = 0; k < s; ++k) {
+            count += sub_count(b, k);
+        }
+        uint32_t w = b * RS_BLOCK_WORDS + s * RS_SUB_WORDS;
+        for (; w < (i >> WORD_SHIFT); ++w) {
+            count += popcount(m_words[w]);
+        }
+        if (i & WORD_MASK) {
+            count += popcount(m_words[w] & ((WORD_ONE << (i & WORD_MASK)) - 1));
+        }
+        return count;
+    }
+
+    // function to count zeros in bits [0, i)
+    inline uint32_t rank0(const uint32_t i) const { return i - rank(i); }
+
+    // function to find the position of the k^th one counting from 0, returns
+    // size if there are not that many ones
+    uint32_t select(uint32_t k) const {
+        if (k >= m_ones) return m_bits;
+
+        // binary search for the last block with fewer than k ones before it
+        uint32_t lo = m_samples[k >> RS_SAMPLE_SHIFT];
+        uint32_t hi = m_samples[(k >> RS_SAMPLE_SHIFT) + 1] + 1;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) >> 1;
+            if (before(mid) <= k) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        k -= before(lo);
+
+        // walk the sub-blocks then the words
+        uint32_t s = 0;
+        for (; s < 3 && k >= sub_count(lo, s); ++s) {
+            k -= sub_count(lo, s);
+        }
+        uint32_t w = lo * RS_BLOCK_WORDS + s * RS_SUB_WORDS;
+        for (uint32_t c = popcount(m_words[w]); k >= c;
+             c = popcount(m_words[w])) {
+            k -= c;
+            ++w;
+        }
+        return (w << WORD_SHIFT) + select_word(m_words[w], k);
+    }
+
+    // function to see how many bits are set to 1 in the set
+    inline uint32_t count(void) const { return m_ones; }
+
+    // function to find the size of the index in bits
+    inline uint64_t overhead(void) const {
+        return 64 * m_blocks.capacity() + 32 * m_samples.capacity();
+    }
+};
+
+}  // namespace cj
+
+#endif  // RANKSELECT_HPP
@@ -0,0 +1,715 @@
+/**
+ * RoaringBits.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Compressed bit set over 32 bit values in the style of Roaring bitmaps
+ * (Chambi, Lemire et al.). Values are split by their high 16 bits into chunks
+ * of 65536, each chunk is stored in the smallest of: a sorted array of its
+ * low 16 bits, a 65536 bit bitmap, or a list of runs.
+ */
+
+#ifndef ROARINGBITS_HPP
+#define ROARINGBITS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "BitKernels.hpp"
+#include "DenseBits.hpp"
+
+namespace cj {
+
+static const uint32_t ROARING_ARRAY_MAX = 4096;  // largest array container
+static const uint32_t ROARING_WORDS = 1024;      // words in a bitmap
+
+/*----------------------------------------------------------------------------*/
+
+// helpers for ranges [lo, hi] inclusive of bits in a bitmap
+
+// function to set bits lo to hi
+inline void set_range(uint64_t *words, const uint32_t lo, const uint32_t hi) {
+    const uint32_t first = lo >> WORD_SHIFT;
+    const uint32_t last = hi >> WORD_SHIFT;
+    const uint64_t head = ~0ULL << (lo & WORD_MASK);
+    const uint64_t tail = ~0ULL >> (WORD_MASK - (hi & WORD_MASK));
+    if (first == last) {
+        words[first] |= head & tail;
+        return;
+    }
+    words[first] |= head;
+    for (uint32_t w = first + 1; w < last; ++w) {
+        words[w] = ~0ULL;
+    }
+    words[last] |= tail;
+}
+
+// function to count bits set between lo and hi
+inline uint32_t count_range(const uint64_t *words, const uint32_t lo,
+                            const uint32_t hi) {
+    const uint32_t first = lo >> WORD_SHIFT;
+    const uint32_t last = hi >> WORD_SHIFT;
+    const uint64_t head = ~0ULL << (lo & WORD_MASK);
+    const uint64_t tail = ~0ULL >> (WORD_MASK - (hi & WORD_MASK));
+    if (first == last) return popcount(words[first] & head & tail);
+    uint32_t count = popcount(words[first] & head);
+    for (uint32_t w = first + 1; w < last; ++w) {
+        count += popcount(words[w]);
+    }
+    return count + popcount(words[last] & tail);
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Class holding the low 16 bits of the values in one chunk, as an ARRAY, a
+// BITMAP or RUNs, methods: contains(), add(), remove(), cardinality(),
+// bytes(), optimise(), for_each(). Only the vector matching kind is used.
+class RoaringContainer {
+   public:
+    enum Kind : uint8_t { ARRAY, BITMAP, RUN };
+
+    // struct for a run of consecutive values [start, last]
+    struct Run {
+        uint16_t start;
+        uint16_t last;
+    };
+
+    Kind kind = ARRAY;
+    uint32_t card = 0;
+
+    std::vector<uint16_t> array;   // sorted values
+    std::vector<uint64_t> bitmap;  // ROARING_WORDS words
+    std::vector<Run> runs;         // sorted, non touching runs
+
+   private:
+    // first run with start > x
+    inline std::vector<Run>::iterator run_after(const uint16_t x) {
+        return std::upper_bound(
+            runs.begin(), runs.end(), x,
+            [](const uint16_t v, const Run &r) { return v < r.start; });
+    }
+
+    inline std::vector<Run>::const_iterator run_after(const uint16_t x) const {
+        return std::upper_bound(
+            runs.begin(), runs.end(), x,
+            [](const uint16_t v, const Run &r) { return v < r.start; });
+    }
+
+    template <typename V>
+    static inline void release(std::vector<V> &v) {
+        std::vector<V>().swap(v);
+    }
+
+   public:
+    // function to test if x is in the container
+    bool contains(const uint16_t x) const {
+        switch (kind) {
+            case ARRAY:
+                return std::binary_search(array.begin(), array.end(), x);
+            case BITMAP:
+                return (bitmap[x >> WORD_SHIFT] >> (x & WORD_MASK)) & 1;
+            default: {
+                auto it = run_after(x);
+                return it != runs.begin() && (it - 1)->last >= x;
+            }
+        }
+    }
+
+    // function to add x to the container
+    void add(const uint16_t x) {
+        switch (kind) {
+            case ARRAY: {
+                auto it = std::lower_bound(array.begin(), array.end(), x);
+                if (it != array.end() && *it == x) return;
+                array.insert(it, x);
+                if (++card > ROARING_ARRAY_MAX) to_bitmap();
+                return;
+            }
+            case BITMAP: {
+                uint64_t &word = bitmap[x >> WORD_SHIFT];
+                uint64_t mask = WORD_ONE << (x & WORD_MASK);
+                card += (word & mask) == 0;
+                word |= mask;
+                return;
+            }
+            default: {
+                auto it = run_after(x);
+                if (it != runs.begin() && (it - 1)->last >= x) return;
+                bool join_prev =
+                    it != runs.begin() && (it - 1)->last + 1u == x;
+                bool join_next = it != runs.end() && it->start == x + 1u;
+                if (join_prev && join_next) {
+                    (it - 1)->last = it->last;
+                    runs.erase(it);
+                } else if (join_prev) {
+                    (it - 1)->last = x;
+                } else if (join_next) {
+                    it->start = x;
+                } else {
+                    runs.insert(it, Run{x, x});
+                }
+                ++card;
+                return;
+            }
+        }
+    }
+
+    // function to remove x from the container
+    void remove(const uint16_t x) {
+        switch (kind) {
+            case ARRAY: {
+                auto it = std::lower_bound(array.begin(), array.end(), x);
+                if (it == array.end() || *it != x) return;
+                array.erase(it);
+                --card;
+                return;
+            }
+            case BITMAP: {
+                uint64_t &word = bitmap[x >> WORD_SHIFT];
+                uint64_t mask = WORD_ONE << (x & WORD_MASK);
+                if ((word & mask) == 0) return;
+                word &= ~mask;
+                if (--card <= ROARING_ARRAY_MAX) to_array();
+                return;
+            }
+            default: {
+                auto it = run_after(x);
+                if (it == runs.begin() || (it - 1)->last < x) return;
+                --it;
+                Run r = *it;
+                if (r.start == r.last) {
+                    runs.erase(it);
+                } else if (x == r.start) {
+                    ++it->start;
+                } else if (x == r.last) {
+                    --it->last;
+                } else {
+                    it->last = x - 1;
+                    runs.insert(it + 1, Run{static_cast<uint16_t>(x + 1),
+                                            r.last});
+                }
+                --card;
+                return;
+            }
+        }
+    }
+
+    // return number of values in container
+    inline uint32_t cardinality(void) const { return card; }
+
+    // function to call f(x) for each value in increasing order
+    template <typename F>
+    void for_each(F &&f) const {
+        switch (kind) {
+            case ARRAY:
+                for (uint16_t x : array) f(x);
+                return;
+            case BITMAP:
+                for (uint64_t x : OnesRange(bitmap.data(), ROARING_WORDS)) {
+                    f(static_cast<uint16_t>(x));
+                }
+                return;
+            default:
+                for (const Run &r : runs) {
+                    for (uint32_t x = r.start; x <= r.last; ++x) {
+                        f(static_cast<uint16_t>(x));
+                    }
+                }
+                return;
+        }
+    }
+
+    // function to count the runs of consecutive values
+    uint32_t count_runs(void) const {
+        switch (kind) {
+            case ARRAY: {
+                uint32_t n = !array.empty();
+                for (size_t i = 1; i < array.size(); ++i) {
+                    n += array[i] != array[i - 1] + 1;
+                }
+                return n;
+            }
+            case BITMAP: {
+                // a run starts at each 1 whose lower neighbour is 0
+                uint32_t n = 0;
+                uint64_t carry = 0;
+                for (uint32_t w = 0; w < ROARING_WORDS; ++w) {
+                    n += popcount(bitmap[w] & ~((bitmap[w] << 1) | carry));
+                    carry = bitmap[w] >> WORD_MASK;
+                }
+                return n;
+            }
+            default:
+                return static_cast<uint32_t>(runs.size());
+        }
+    }
+
+    // return the bytes used by each representation
+    static inline size_t array_bytes(uint32_t card) { return 2 * card; }
+    static inline size_t bitmap_bytes(void) { return 8 * ROARING_WORDS; }
+    static inline size_t run_bytes(uint32_t n_runs) { return 4 * n_runs; }
+
+    // return the bytes used by the current representation
+    size_t bytes(void) const {
+        switch (kind) {
+            case ARRAY:
+                return array_bytes(card);
+            case BITMAP:
+                return bitmap_bytes();
+            default:
+                return run_bytes(static_cast<uint32_t>(runs.size()));
+        }
+    }
+
+    /*------------------------------Conversions-------------------------------*/
+
+    void to_bitmap(void) {
+        if (kind == BITMAP) return;
+        std::vector<uint64_t> tmp(ROARING_WORDS, 0);
+        for_each([&](const uint16_t x) {
+            tmp[x >> WORD_SHIFT] |= WORD_ONE << (x & WORD_MASK);
+        });
+        bitmap.swap(tmp);
+        release(array);
+        release(runs);
+        kind = BITMAP;
+    }
+
+    void to_array(void) {
+        if (kind == ARRAY) return;
+        std::vector<uint16_t> tmp;
+        tmp.reserve(card);
+        for_each([&](const uint16_t x) { tmp.push_back(x); });
+        array.swap(tmp);
+        release(bitmap);
+        release(runs);
+        kind = ARRAY;
+    }
+
+    void to_runs(void) {
+        if (kind == RUN) return;
+        std::vector<Run> tmp;
+        tmp.reserve(count_runs());
+        for_each([&](const uint16_t x) {
+            if (!tmp.empty() && tmp.back().last + 1u == x) {
+                tmp.back().last = x;
+            } else {
+                tmp.push_back(Run{x, x});
+            }
+        });
+        runs.swap(tmp);
+        release(array);
+        release(bitmap);
+        kind = RUN;
+    }
+
+    // function to switch to the smallest representation
+    void optimise(void) {
+        size_t run = run_bytes(count_runs());
+        size_t rest = card <= ROARING_ARRAY_MAX ? array_bytes(card)
+                                                : bitmap_bytes();
+        if (run < rest) {
+            to_runs();
+        } else if (card <= ROARING_ARRAY_MAX) {
+            to_array();
+        } else {
+            to_bitmap();
+        }
+    }
+
+    // function to pick array or bitmap for a freshly built bitmap
+    inline void settle_bitmap(void) {
+        kind = BITMAP;
+        card = static_cast<uint32_t>(
+            popcount_words(bitmap.data(), ROARING_WORDS));
+        if (card <= ROARING_ARRAY_MAX) to_array();
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// functions between containers, each returns a new container or a count.
+// Runs are merged with runs directly, other run pairings go through a bitmap.
+
+// count of the values in both a and b
+inline uint32_t intersect_count(const RoaringContainer &a,
+                                const RoaringContainer &b) {
+    typedef RoaringContainer C;
+    if (a.kind > b.kind) return intersect_count(b, a);
+
+    if (a.kind == C::ARRAY) {
+        uint32_t n = 0;
+        if (b.kind == C::ARRAY) {
+            auto i = a.array.begin();
+            auto j = b.array.begin();
+            while (i != a.array.end() && j != b.array.end()) {
+                if (*i < *j) {
+                    ++i;
+                } else if (*j < *i) {
+                    ++j;
+                } else {
+                    ++n, ++i, ++j;
+                }
+            }
+        } else {
+            for (uint16_t x : a.array) n += b.contains(x);
+        }
+        return n;
+    }
+    if (a.kind == C::BITMAP) {
+        if (b.kind == C::BITMAP) {
+            return static_cast<uint32_t>(count_words<OpAnd>(
+                a.bitmap.data(), b.bitmap.data(), ROARING_WORDS));
+        }
+        uint32_t n = 0;
+        for (const C::Run &r : b.runs) {
+            n += count_range(a.bitmap.data(), r.start, r.last);
+        }
+        return n;
+    }
+    // run and run, sum the overlaps
+    uint32_t n = 0;
+    auto i = a.runs.begin();
+    auto j = b.runs.begin();
+    while (i != a.runs.end() && j != b.runs.end()) {
+        uint32_t lo = std::max(i->start, j->start);
+        uint32_t hi = std::min(i->last, j->last);
+        if (lo <= hi) n += hi - lo + 1;
+        if (i->last < j->last) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return n;
+}
+
+// container of the values in both a and b
+inline RoaringContainer intersect(const RoaringContainer &a,
+                                  const RoaringContainer &b) {
+    typedef RoaringContainer C;
+    if (a.kind > b.kind) return intersect(b, a);
+
+    C out;
+    if (a.kind == C::ARRAY) {
+        // array results are never bigger than the input array
+        out.array.reserve(a.card);
+        if (b.kind == C::ARRAY) {
+            std::set_intersection(a.array.begin(), a.array.end(),
+                                  b.array.begin(), b.array.end(),
+                                  std::back_inserter(out.array));
+        } else {
+            for (uint16_t x : a.array) {
+                if (b.contains(x)) out.array.push_back(x);
+            }
+        }
+        out.card = static_cast<uint32_t>(out.array.size());
+        return out;
+    }
+    if (a.kind == C::BITMAP) {
+        out.bitmap.assign(ROARING_WORDS, 0);
+        if (b.kind == C::BITMAP) {
+            apply_words<OpAnd>(out.bitmap.data(), a.bitmap.data(),
+                               b.bitmap.data(), ROARING_WORDS);
+        } else {
+            // runs can share a word so or in the masked words
+            for (const C::Run &r : b.runs) {
+                const uint32_t first = r.start >> WORD_SHIFT;
+                const uint32_t last = r.last >> WORD_SHIFT;
+                for (uint32_t w = first; w <= last; ++w) {
+                    uint64_t mask = ~0ULL;
+                    if (w == first) mask &= ~0ULL << (r.start & WORD_MASK);
+                    if (w == last) {
+                        mask &= ~0ULL >> (WORD_MASK - (r.last & WORD_MASK));
+                    }
+                    out.bitmap[w] |= a.bitmap[w] & mask;
+                }
+            }
+        }
+        out.settle_bitmap();
+        return out;
+    }
+    // run and run
+    out.kind = C::RUN;
+    auto i = a.runs.begin();
+    auto j = b.runs.begin();
+    while (i != a.runs.end() && j != b.runs.end()) {
+        uint16_t lo = std::max(i->start, j->start);
+        uint16_t hi = std::min(i->last, j->last);
+        if (lo <= hi) {
+            out.runs.push_back(C::Run{lo, hi});
+            out.card += hi - lo + 1u;
+        }
+        if (i->last < j->last) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return out;
+}
+
+// container of the values in a or b
+inline RoaringContainer unite(const RoaringContainer &a,
+                              const RoaringContainer &b) {
+    typedef RoaringContainer C;
+    if (a.kind > b.kind) return unite(b, a);
+
+    C out;
+    if (a.kind == C::ARRAY && b.kind == C::ARRAY &&
+        a.card + b.card <= ROARING_ARRAY_MAX) {
+        out.array.reserve(a.card + b.card);
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(),
+                       b.array.end(), std::back_inserter(out.array));
+        out.card = static_cast<uint32_t>(out.array.size());
+        return out;
+    }
+    if (a.kind == C::RUN || (a.kind == C::ARRAY && b.kind == C::RUN &&
+                             a.card < 2 * b.runs.size())) {
+        // merge two sorted run lists, an array is a list of unit runs
+        out.kind = C::RUN;
+        std::vector<C::Run> left;
+        const std::vector<C::Run> *lhs = &a.runs;
+        if (a.kind == C::ARRAY) {
+            left.reserve(a.card);
+            for (uint16_t x : a.array) left.push_back(C::Run{x, x});
+            lhs = &left;
+        }
+        auto i = lhs->begin();
+        auto j = b.runs.begin();
+        while (i != lhs->end() || j != b.runs.end()) {
+            C::Run r;
+            if (j == b.runs.end() || (i != lhs->end() && i->start < j->start)) {
+                r = *i++;
+            } else {
+                r = *j++;
+            }
+            if (!out.runs.empty() && out.runs.back().last + 1u >= r.start) {
+                if (r.last > out.runs.back().last) {
+                    out.card += r.last - out.runs.back().last;
+                    out.runs.back().last = r.last;
+                }
+            } else {
+                out.runs.push_back(r);
+                out.card += r.last - r.start + 1u;
+            }
+        }
+        return out;
+    }
+    // everything else goes through a bitmap
+    out.bitmap.assign(ROARING_WORDS, 0);
+    const C *other = &b;
+    if (b.kind == C::BITMAP) {
+        out.bitmap = b.bitmap;
+        other = &a;
+    } else if (a.kind == C::BITMAP) {
+        out.bitmap = a.bitmap;
+    } else {
+        a.for_each([&](const uint16_t x) {
+            out.bitmap[x >> WORD_SHIFT] |= WORD_ONE << (x & WORD_MASK);
+        });
+    }
+    switch (other->kind) {
+        case C::ARRAY:
+            for (uint16_t x : other->array) {
+                out.bitmap[x >> WORD_SHIFT] |= WORD_ONE << (x & WORD_MASK);
+            }
+            break;
+        case C::BITMAP:
+            apply_words<OpOr>(out.bitmap.data(), out.bitmap.data(),
+                              other->bitmap.data(), ROARING_WORDS);
+            break;
+        default:
+            for (const C::Run &r : other->runs) {
+                set_range(out.bitmap.data(), r.start, r.last);
+            }
+    }
+    out.settle_bitmap();
+    return out;
+}
+
+/*----------------------------------------------------------------------------*/
+
+class RoaringBits;
+inline RoaringBits operator&(const RoaringBits &a, const RoaringBits &b);
+inline RoaringBits operator|(const RoaringBits &a, const RoaringBits &b);
+
+// Compressed set of 32 bit values, methods: add(), remove(), contains(),
+// cardinality(), bytes(), optimise(), for_each() and whole set &, |, &=, |=.
+// intersect_count(a, b) gives (a & b).cardinality() without building it.
+class RoaringBits {
+   public:
+    std::vector<uint16_t> keys;  // sorted high 16 bits
+    std::vector<RoaringContainer> containers;
+
+   private:
+    static inline uint16_t high(const uint32_t x) { return x >> 16; }
+    static inline uint16_t low(const uint32_t x) { return x & 0xFFFF; }
+
+    // position of key or where it would be inserted
+    inline size_t find(const uint16_t key) const {
+        return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    }
+
+   public:
+    // function to add x to the set
+    void add(const uint32_t x) {
+        size_t i = find(high(x));
+        if (i == keys.size() || keys[i] != high(x)) {
+            keys.insert(keys.begin() + i, high(x));
+            containers.insert(containers.begin() + i, RoaringContainer());
+        }
+        containers[i].add(low(x));
+    }
+
+    // function to remove x from the set
+    void remove(const uint32_t x) {
+        size_t i = find(high(x));
+        if (i == keys.size() || keys[i] != high(x)) return;
+        containers[i].remove(low(x));
+        if (containers[i].card == 0) {
+            keys.erase(keys.begin() + i);
+            containers.erase(containers.begin() + i);
+        }
+    }
+
+    // function to test if x is in the set
+    bool contains(const uint32_t x) const {
+        size_t i = find(high(x));
+        return i != keys.size() && keys[i] == high(x) &&
+               containers[i].contains(low(x));
+    }
+
+    // return number of values in the set
+    uint64_t cardinality(void) const {
+        uint64_t count = 0;
+        for (const RoaringContainer &c : containers) count += c.card;
+        return count;
+    }
+
+    // return approximate bytes used by the containers' contents
+    size_t bytes(void) const {
+        size_t count = keys.size() * (2 + sizeof(RoaringContainer));
+        for (const RoaringContainer &c : containers) count += c.bytes();
+        return count;
+    }
+
+    // function to switch every container to its smallest representation,
+    // call after building a set that has long runs
+    void optimise(void) {
+        for (RoaringContainer &c : containers) c.optimise();
+    }
+
+    // function to call f(x) for each value in increasing order
+    template <typename F>
+    void for_each(F &&f) const {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            const uint32_t base = static_cast<uint32_t>(keys[i]) << 16;
+            containers[i].for_each([&](const uint16_t x) { f(base | x); });
+        }
+    }
+
+    // function to build from the set bits of a word bit set
+    template <class E>
+    static RoaringBits from(const WordBits<E> &bits) {
+        RoaringBits out;
+        for (uint64_t x : bits.ones()) out.add(static_cast<uint32_t>(x));
+        out.optimise();
+        return out;
+    }
+
+    /*--------------------------Whole set operations--------------------------*/
+
+    inline RoaringBits &operator&=(const RoaringBits &other) {
+        *this = *this & other;
+        return *this;
+    }
+
+    inline RoaringBits &operator|=(const RoaringBits &other) {
+        *this = *this | other;
+        return *this;
+    }
+
+    // function to print a summary of the containers
+    void report(void) const {
+        static const char *names[] = {"array", "bitmap", "run"};
+        cout << "#=======Report, Start=======#" << endl;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            cout << keys[i] << ": " << names[containers[i].kind] << " "
+                 << containers[i].card << " values " << containers[i].bytes()
+                 << " bytes" << endl;
+        }
+        cout << "#=======Report, End=======#" << endl;
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// functions between whole sets
+inline RoaringBits operator&(const RoaringBits &a, const RoaringBits &b) {
+    RoaringBits out;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.keys.size() && j < b.keys.size()) {
+        if (a.keys[i] < b.keys[j]) {
+            ++i;
+        } else if (b.keys[j] < a.keys[i]) {
+            ++j;
+        } else {
+            RoaringContainer c =
+                intersect(a.containers[i], b.containers[j]);
+            if (c.card != 0) {
+                out.keys.push_back(a.keys[i]);
+                out.containers.push_back(std::move(c));
+            }
+            ++i, ++j;
+        }
+    }
+    return out;
+}
+
+inline RoaringBits operator|(const RoaringBits &a, const RoaringBits &b) {
+    RoaringBits out;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.keys.size() || j < b.keys.size()) {
+        if (j == b.keys.size() ||
+            (i < a.keys.size() && a.keys[i] < b.keys[j])) {
+            out.keys.push_back(a.keys[i]);
+            out.containers.push_back(a.containers[i++]);
+        } else if (i == a.keys.size() || b.keys[j] < a.keys[i]) {
+            out.keys.push_back(b.keys[j]);
+            out.containers.push_back(b.containers[j++]);
+        } else {
+            out.keys.push_back(a.keys[i]);
+            out.containers.push_back(
+                unite(a.containers[i++], b.containers[j++]));
+        }
+    }
+    return out;
+}
+
+// count of the values in both a and b
+inline uint64_t intersect_count(const RoaringBits &a, const RoaringBits &b) {
+    uint64_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.keys.size() && j < b.keys.size()) {
+        if (a.keys[i] < b.keys[j]) {
+            ++i;
+        } else if (b.keys[j] < a.keys[i]) {
+            ++j;
+        } else {
+            count += intersect_count(a.containers[i++], b.containers[j++]);
+        }
+    }
+    return count;
+}
+
+}  // namespace cj
+
+#endif  // ROARINGBITS_HPP
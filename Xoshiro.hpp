@@ -0,0 +1,132 @@
+/**
+ * Xoshiro.hpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * xoshiro256** pseudo random number generator (D. Blackman and S. Vigna).
+ * Small, fast and with jump() to split one seed into independent streams,
+ * e.g. one per thread or replica. Also threshold() and mix64(), for turning
+ * random words into accept decisions and hashing seeds.
+ */
+
+#ifndef XOSHIRO_HPP
+#define XOSHIRO_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace cj {
+
+// Class for a xoshiro256** generator with a period of 2^256 - 1, usable
+// with the <random> distributions. Methods: operator(), uniform(), below(),
+// seed(), jump(), long_jump().
+class Xoshiro256 {
+    uint64_t s[4];
+
+    static inline uint64_t rotl(const uint64_t x, const int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    // advance by the polynomial in table, helper for the jumps
+    inline void advance(const uint64_t (&table)[4]) {
+        uint64_t t[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 4; ++i) {
+            for (int b = 0; b < 64; ++b) {
+                if (table[i] & (uint64_t(1) << b)) {
+                    t[0] ^= s[0];
+                    t[1] ^= s[1];
+                    t[2] ^= s[2];
+                    t[3] ^= s[3];
+                }
+                (*this)();
+            }
+        }
+        s[0] = t[0];
+        s[1] = t[1];
+        s[2] = t[2];
+        s[3] = t[3];
+    }
+
+   public:
+    using result_type = uint64_t;
+
+    static constexpr uint64_t min(void) { return 0; }
+    static constexpr uint64_t max(void) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    // function to get the next 64 random bits
+    inline uint64_t operator()(void) {
+        const uint64_t out = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return out;
+    }
+
+    // function to get a double uniform in [0, 1)
+    inline double uniform(void) {
+        return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // function to get an integer uniform in [0, n) without a division
+    inline uint64_t below(const uint64_t n) {
+        return static_cast<uint64_t>(
+            (static_cast<unsigned __int128>((*this)()) * n) >> 64);
+    }
+
+    // function to set the state from one word using splitmix64
+    void seed(uint64_t x) {
+        for (int i = 0; i < 4; ++i) {
+            uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            s[i] = z ^ (z >> 31);
+        }
+    }
+
+    // function equivalent to 2^128 calls, gives 2^128 non-overlapping streams
+    void jump(void) {
+        static const uint64_t JUMP[4] = {
+            0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+            0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+        advance(JUMP);
+    }
+
+    // function equivalent to 2^192 calls, e.g. one per process
+    void long_jump(void) {
+        static const uint64_t LONG_JUMP[4] = {
+            0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+            0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+        advance(LONG_JUMP);
+    }
+
+    // constructor
+    explicit Xoshiro256(const uint64_t x = 0x2545f4914f6cdd1dULL) { seed(x); }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// function to get the integer threshold t with P(rng() < t) = p
+inline uint64_t threshold(const double p) {
+    if (p <= 0) return 0;
+    if (p >= 1) return ~uint64_t(0);
+    return static_cast<uint64_t>(std::ldexp(p, 64));
+}
+
+// function to scramble x into 64 well mixed bits (splitmix64 finaliser)
+inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+}  // namespace cj
+
+#endif  // XOSHIRO_HPP
@@ -0,0 +1,324 @@
+/**
+ * bits_bench.cpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Benchmarks comparing the byte backend of DenseBitsH (ByteOfBits, counted
+ * with its popcount or with the BitsSetTable256 lookup) with 64 bit words
+ * processed one at a time and with the SIMD kernels in BitKernels.hpp.
+ * Covers ByteOfBits on its own, count(), random and sequential test()/flip(),
+ * whole set xor and or and the fused count_and() for sets of 64 bits up to
+ * 1 Gbit.
+ *
+ * Build from the repository root with:
+ *
+ *     g++ -O3 -march=native -std=c++14 -I. bench/bits_bench.cpp \
+ *         -o bits_bench
+ *
+ * Build without -march=native (or with -mno-avx2) to time the scalar
+ * fallbacks of the SIMD kernels. At -O3 the compiler may vectorise the byte
+ * and word loops as well, add -fno-tree-vectorize to time them one element
+ * at a time. The 1 Gbit sets need about 512 MB.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BitKernels.hpp"
+#include "BitsSetTable256.hpp"
+#include "DenseBits.hpp"
+
+using std::cout;
+using std::endl;
+
+using Clock = std::chrono::steady_clock;
+
+static volatile uint64_t sink = 0;  // stops the optimiser removing loops
+
+// stops the optimiser merging or hoisting repeats of a whole set operation
+static inline void clobber(void) { asm volatile("" : : : "memory"); }
+
+static const uint64_t BIT_OPS = 1 << 22;      // single bit ops per test
+static const uint64_t BULK_BITS = 1ULL << 32;  // bits touched per bulk test
+
+/*----------------------------------------------------------------------------*/
+
+// function to time f() and return nanoseconds per op
+template <typename F>
+double time_ns(uint64_t ops, F &&f) {
+    auto start = Clock::now();
+    f();
+    auto stop = Clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() /
+           ops;
+}
+
+// prints one result, bits > 0 adds the throughput in Gbit/s
+void row(const std::string &test, const char *backend, double ns,
+         uint64_t bits = 0) {
+    cout << std::left << std::setw(28) << test << std::setw(14) << backend
+         << std::right << std::setw(14) << std::fixed << std::setprecision(2)
+         << ns << " ns/op";
+    if (bits != 0) {
+        cout << std::setw(12) << std::setprecision(2) << bits / ns
+             << " Gbit/s";
+    }
+    cout << endl;
+}
+
+std::string label(const char *test, uint64_t bits) {
+    static const char *unit[] = {"", "K", "M", "G"};
+    int u = 0;
+    while (bits >= 1024 && bits % 1024 == 0 && u < 3) {
+        bits /= 1024;
+        ++u;
+    }
+    return std::string(test) + " " + std::to_string(bits) + unit[u] + "bit";
+}
+
+const char *simd_name(void) {
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512F__)
+    return "avx512";
+#elif defined(__AVX2__)
+    return "avx2";
+#else
+    return "scalar";
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+
+// Word loops without the SIMD kernels, one 64 bit word per iteration
+
+uint64_t scalar_count(const uint64_t *words, const uint64_t n) {
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < n; ++i) count += cj::popcount(words[i]);
+    return count;
+}
+
+template <class Op>
+void scalar_apply(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+                  const uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) dst[i] = Op::word(a[i], b[i]);
+}
+
+// function to count a byte set one BitsSetTable256 lookup per byte
+template <uint32_t N>
+uint64_t table_count(const cj::DenseBitsH<N> &a) {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < cj::DenseBitsH<N>::length; ++i) {
+        count += cj::BitsSetTable256[a.set[i].data()];
+    }
+    return count;
+}
+
+// the byte backend has no whole set operations, combine ByteOfBits directly
+template <class Op, uint32_t N>
+void byte_apply(cj::DenseBitsH<N> &a, cj::DenseBitsH<N> &b) {
+    for (uint32_t i = 0; i < cj::DenseBitsH<N>::length; ++i) {
+        a.set[i] = cj::ByteOfBits(static_cast<uint8_t>(
+            Op::word(a.set[i].data(), b.set[i].data())));
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+
+// test() and flip() on a single byte
+void bench_byte(void) {
+    cj::ByteOfBits byte(0x5a);
+    double ns = time_ns(BIT_OPS, [&] {
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < BIT_OPS; ++i) count += byte.test(i & 7);
+        sink += count;
+    });
+    row("ByteOfBits test", "byte", ns);
+
+    ns = time_ns(BIT_OPS, [&] {
+        for (uint64_t i = 0; i < BIT_OPS; ++i) byte.flip(i & 7);
+        sink += byte.data();
+    });
+    row("ByteOfBits flip", "byte", ns);
+
+    ns = time_ns(BIT_OPS, [&] {
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < BIT_OPS; ++i) {
+            byte.flip(i & 7);
+            count += byte.count();
+        }
+        sink += count;
+    });
+    row("ByteOfBits flip+count", "byte", ns);
+    cout << endl;
+}
+
+template <uint32_t N>
+void bench_size(std::mt19937_64 &rng) {
+    cj::DenseBitsH<N> ha, hb;
+    cj::DynamicBits wa(N), wb(N);
+    const uint64_t n = wa.n_words();
+    // the byte and word layouts match, so fill the words and copy them over
+    for (uint64_t i = 0; i < n; ++i) {
+        wa.words()[i] = rng();
+        wb.words()[i] = rng();
+    }
+    const uint32_t bytes = cj::DenseBitsH<N>::length;
+    std::memcpy(static_cast<void *>(ha.set), wa.words(), bytes);
+    std::memcpy(static_cast<void *>(hb.set), wb.words(), bytes);
+    const uint64_t reps = std::max<uint64_t>(1, BULK_BITS / N);
+
+    std::vector<uint32_t> random(BIT_OPS);
+    for (uint32_t &bit : random) bit = rng() % N;
+
+    // whole set count
+    double ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            sink += ha.count();
+            clobber();
+        }
+    });
+    row(label("count", N), "byte popcount", ns, N);
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            sink += table_count(ha);
+            clobber();
+        }
+    });
+    row(label("count", N), "byte table", ns, N);
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            sink += scalar_count(wa.words(), n);
+            clobber();
+        }
+    });
+    row(label("count", N), "word", ns, N);
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            sink += wa.count();
+            clobber();
+        }
+    });
+    row(label("count", N), simd_name(), ns, N);
+
+    // single bits at random positions
+    ns = time_ns(BIT_OPS, [&] {
+        uint64_t count = 0;
+        for (uint32_t bit : random) count += ha.test(bit);
+        sink += count;
+    });
+    row(label("random test", N), "byte", ns);
+    ns = time_ns(BIT_OPS, [&] {
+        uint64_t count = 0;
+        for (uint32_t bit : random) count += wa.test(bit);
+        sink += count;
+    });
+    row(label("random test", N), "word", ns);
+    ns = time_ns(BIT_OPS, [&] {
+        for (uint32_t bit : random) ha.flip(bit);
+    });
+    row(label("random flip", N), "byte", ns);
+    ns = time_ns(BIT_OPS, [&] {
+        for (uint32_t bit : random) wa.flip(bit);
+    });
+    row(label("random flip", N), "word", ns);
+
+    // single bits in order, wrapping for sets smaller than BIT_OPS
+    ns = time_ns(BIT_OPS, [&] {
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < BIT_OPS; ++i) count += ha.test(i % N);
+        sink += count;
+    });
+    row(label("sequential test", N), "byte", ns);
+    ns = time_ns(BIT_OPS, [&] {
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < BIT_OPS; ++i) count += wa.test(i % N);
+        sink += count;
+    });
+    row(label("sequential test", N), "word", ns);
+
+    // whole set operations, a = a op b
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            byte_apply<cj::OpXor>(ha, hb);
+            clobber();
+        }
+        sink += ha.set[0].data();
+    });
+    row(label("xor", N), "byte", ns, N);
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            scalar_apply<cj::OpXor>(wa.words(), wa.words(), wb.words(), n);
+            clobber();
+        }
+        sink += wa.words()[0];
+    });
+    row(label("xor", N), "word", ns, N);
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            wa ^= wb;
+            clobber();
+        }
+        sink += wa.words()[0];
+    });
+    row(label("xor", N), simd_name(), ns, N);
+
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            byte_apply<cj::OpOr>(ha, hb);
+            clobber();
+        }
+        sink += ha.set[0].data();
+    });
+    row(label("or", N), "byte", ns, N);
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            scalar_apply<cj::OpOr>(wa.words(), wa.words(), wb.words(), n);
+            clobber();
+        }
+        sink += wa.words()[0];
+    });
+    row(label("or", N), "word", ns, N);
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            wa |= wb;
+            clobber();
+        }
+        sink += wa.words()[0];
+    });
+    row(label("or", N), simd_name(), ns, N);
+
+    // fused and + count against building the intersection
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            sink += (wa & wb).count();
+            clobber();
+        }
+    });
+    row(label("(a & b).count", N), simd_name(), ns, N);
+    ns = time_ns(reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            sink += cj::count_and(wa, wb);
+            clobber();
+        }
+    });
+    row(label("count_and", N), simd_name(), ns, N);
+    cout << endl;
+}
+
+int main(void) {
+    std::mt19937_64 rng(42);
+    bench_byte();
+    bench_size<64>(rng);
+    bench_size<1 << 12>(rng);
+    bench_size<1 << 18>(rng);
+    bench_size<1 << 24>(rng);
+    bench_size<1U << 30>(rng);
+    return sink == 42;
+}
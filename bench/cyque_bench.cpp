@@ -0,0 +1,261 @@
+/**
+ * cyque_bench.cpp
+ *
+ * Copyright (c) 2019, C. J. Williams
+ * All rights reserved.
+ *
+ * Benchmarks comparing Cyque with std::deque and std::list. Covers raw
+ * push/pop throughput, pop_push rotation, bursts that overflow the Cyque node
+ * cache and the latency of handing elements between two threads.
+ *
+ * Build from the repository root with:
+ *
+ *     g++ -O3 -march=native -std=c++14 -pthread -I. bench/cyque_bench.cpp \
+ *         -o cyque_bench
+ *
+ * To add another queue (ring buffer, SPSC, MPMC...) write an adapter with the
+ * same methods as the ones below and add it to the lists in main().
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Cyque.hpp"
+
+using std::cout;
+using std::endl;
+
+using Clock = std::chrono::steady_clock;
+
+static volatile uint64_t sink = 0;  // stops the optimiser removing loops
+
+/*----------------------------------------------------------------------------*/
+
+// Adapters giving every queue the interface: push(), pop(), first(),
+// pop_push(), size()
+
+template <typename T>
+struct CyqueQ {
+    static const char *name() { return "Cyque"; }
+    cj::Cyque<T> q;
+    inline void push(T in) { q.push(in); }
+    inline void pop() { q.pop(); }
+    inline T &first() { return q.first(); }
+    inline void pop_push() { q.pop_push(); }
+    inline unsigned long size() { return q.size(); }
+};
+
+template <typename T>
+struct DequeQ {
+    static const char *name() { return "std::deque"; }
+    std::deque<T> q;
+    inline void push(T in) { q.push_back(in); }
+    inline void pop() { q.pop_front(); }
+    inline T &first() { return q.front(); }
+    inline void pop_push() {
+        q.push_back(std::move(q.front()));
+        q.pop_front();
+    }
+    inline unsigned long size() { return q.size(); }
+};
+
+template <typename T>
+struct ListQ {
+    static const char *name() { return "std::list"; }
+    std::list<T> q;
+    inline void push(T in) { q.push_back(in); }
+    inline void pop() { q.pop_front(); }
+    inline T &first() { return q.front(); }
+    inline void pop_push() { q.splice(q.end(), q, q.begin()); }
+    inline unsigned long size() { return q.size(); }
+};
+
+/*----------------------------------------------------------------------------*/
+
+// function to time f() and return nanoseconds per op
+template <typename F>
+double time_ns(uint64_t ops, F &&f) {
+    auto start = Clock::now();
+    f();
+    auto stop = Clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() /
+           ops;
+}
+
+void row(const std::string &test, const char *queue, double ns) {
+    cout << std::left << std::setw(28) << test << std::setw(14) << queue
+         << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+         << ns << " ns/op" << std::setw(12) << std::setprecision(1)
+         << 1e3 / ns << " Mop/s" << endl;
+}
+
+// fill to depth then drain, repeated
+template <typename Q>
+void bench_fill_drain(uint64_t depth, uint64_t reps) {
+    Q q;
+    double ns = time_ns(2 * depth * reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            for (uint64_t i = 0; i < depth; ++i) q.push(i);
+            for (uint64_t i = 0; i < depth; ++i) {
+                sink += q.first();
+                q.pop();
+            }
+        }
+    });
+    row("fill/drain depth=" + std::to_string(depth), Q::name(), ns);
+}
+
+// queue held at fixed depth, one push and one pop per step
+template <typename Q>
+void bench_steady(uint64_t depth, uint64_t steps) {
+    Q q;
+    for (uint64_t i = 0; i < depth; ++i) q.push(i);
+    double ns = time_ns(2 * steps, [&] {
+        for (uint64_t i = 0; i < steps; ++i) {
+            q.push(i);
+            sink += q.first();
+            q.pop();
+        }
+    });
+    row("steady depth=" + std::to_string(depth), Q::name(), ns);
+}
+
+// move the first element to the back
+template <typename Q>
+void bench_rotate(uint64_t depth, uint64_t steps) {
+    Q q;
+    for (uint64_t i = 0; i < depth; ++i) q.push(i);
+    double ns = time_ns(steps, [&] {
+        for (uint64_t i = 0; i < steps; ++i) {
+            sink += q.first();
+            q.pop_push();
+        }
+    });
+    row("pop_push depth=" + std::to_string(depth), Q::name(), ns);
+}
+
+// bursts of pushes then pops around the size of the Cyque node cache
+template <typename Q>
+void bench_burst(uint64_t burst, uint64_t total) {
+    Q q;
+    uint64_t reps = std::max<uint64_t>(1, total / burst);
+    double ns = time_ns(2 * burst * reps, [&] {
+        for (uint64_t r = 0; r < reps; ++r) {
+            for (uint64_t i = 0; i < burst; ++i) q.push(i);
+            for (uint64_t i = 0; i < burst; ++i) {
+                sink += q.first();
+                q.pop();
+            }
+        }
+    });
+    row("burst=" + std::to_string(burst), Q::name(), ns);
+}
+
+/*----------------------------------------------------------------------------*/
+
+// producer pushes its send time, consumer records the time until it sees it.
+// Queues that are not thread safe are guarded with a mutex.
+template <typename Q>
+void bench_handoff(uint64_t messages) {
+    Q q;
+    std::mutex lock;
+    std::atomic<bool> done{false};
+    std::vector<double> latency;
+    latency.reserve(messages);
+
+    std::thread consumer([&] {
+        uint64_t seen = 0;
+        while (seen < messages) {
+            int64_t sent = -1;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (q.size() != 0) {
+                    sent = q.first();
+                    q.pop();
+                }
+            }
+            if (sent < 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              Clock::now().time_since_epoch())
+                              .count();
+            latency.push_back(static_cast<double>(now - sent));
+            ++seen;
+        }
+        done = true;
+    });
+
+    for (uint64_t i = 0; i < messages; ++i) {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          Clock::now().time_since_epoch())
+                          .count();
+        unsigned long backlog;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            q.push(now);
+            backlog = q.size();
+        }
+        // pace the producer so we measure handoff not queue build up
+        while (backlog > 64 && !done) {
+            std::this_thread::yield();
+            std::lock_guard<std::mutex> guard(lock);
+            backlog = q.size();
+        }
+    }
+    consumer.join();
+
+    std::sort(latency.begin(), latency.end());
+    auto pct = [&](double p) {
+        return latency[static_cast<size_t>(p * (latency.size() - 1))];
+    };
+    cout << std::left << std::setw(28) << "handoff latency" << std::setw(14)
+         << Q::name() << std::right << std::fixed << std::setprecision(0)
+         << " p50 " << pct(0.50) << " p90 " << pct(0.90) << " p99 "
+         << pct(0.99) << " p99.9 " << pct(0.999) << " max " << latency.back()
+         << " ns" << endl;
+}
+
+/*----------------------------------------------------------------------------*/
+
+template <typename... Q>
+struct Suite {
+    static void run(void) {
+        const uint64_t ops = 1 << 22;
+
+        for (uint64_t depth : {16ULL, 1024ULL, 65536ULL}) {
+            (void)std::initializer_list<int>{
+                (bench_fill_drain<Q>(depth, ops / depth), 0)...};
+        }
+        cout << endl;
+        for (uint64_t depth : {1ULL, 16ULL, 1024ULL}) {
+            (void)std::initializer_list<int>{(bench_steady<Q>(depth, ops), 0)...};
+        }
+        cout << endl;
+        for (uint64_t depth : {16ULL, 1024ULL, 65536ULL}) {
+            (void)std::initializer_list<int>{(bench_rotate<Q>(depth, ops), 0)...};
+        }
+        cout << endl;
+        for (uint64_t burst : {8ULL, 16ULL, 17ULL, 32ULL, 256ULL, 4096ULL}) {
+            (void)std::initializer_list<int>{(bench_burst<Q>(burst, ops), 0)...};
+        }
+        cout << endl;
+        (void)std::initializer_list<int>{(bench_handoff<Q>(1 << 16), 0)...};
+    }
+};
+
+int main(void) {
+    Suite<CyqueQ<int64_t>, DequeQ<int64_t>, ListQ<int64_t>>::run();
+    return sink == 42;
+}